@@ -1,13 +1,17 @@
 #pragma once
 
+#include <memory>
+
 #include "color.h"
 #include "config.h"
 
 /** BarColors
- * Collection of all colors relevant to the bar.
+ * Collection of all colors relevant to the bar. Font colors are shared with
+ * every other bar using the same color.
  */
 struct BarColors {
   rgba_t background;
-  FontColor foreground;
-  FontColor fg_accent;
+  std::shared_ptr<FontColor> foreground;
+  std::shared_ptr<FontColor> fg_accent;
+  std::shared_ptr<FontColor> fg_urgent;
 };
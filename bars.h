@@ -3,9 +3,12 @@
 #include <algorithm>
 #include <array>
 #include <cstddef>  // size_t
+#include <functional>
 #include <memory>
+#include <optional>
 #include <tuple>
 #include <utility>  // pair
+#include <vector>
 
 #include "bar_color.h"
 #include "modules/module.h"
@@ -25,6 +28,7 @@ class Section {
   Section(padding_t padding, BarWindow* win, std::tuple<const Mods&...> mods);
 
   const SectionPixmap& collect();
+  void resize(BarWindow* win) { win->resize_mod_pixmap(&_pixmap); }
 
   SectionPixmap* get_pixmap() { return &_pixmap; }
 
@@ -62,10 +66,17 @@ Section<Mods...>::collect() {
       },
       _modules);
   _pixmap.pad(_padding.end);
+  _pixmap.finish();
   return _pixmap;
 }
 
 
+struct lookup_value_t {
+  const char* name = nullptr;
+  bool from_rdb = false;
+};
+
+
 template <typename L, typename M, typename R>
 class BarBuilder;
 
@@ -81,19 +92,25 @@ template <typename... Left, typename... Middle, typename... Right>
 class Bar<std::tuple<const Left&...>, std::tuple<const Middle&...>,
           std::tuple<const Right&...>> {
  public:
-  class events_t;
+  using builder_t =
+      BarBuilder<std::tuple<const Left&...>, std::tuple<const Middle&...>,
+                 std::tuple<const Right&...>>;
 
-  explicit Bar(
-      const BarBuilder<std::tuple<const Left&...>, std::tuple<const Middle&...>,
-                       std::tuple<const Right&...>>& builder);
+  explicit Bar(const builder_t& builder) : Bar(builder, builder._rect) {}
+  Bar(const builder_t& builder, rectangle_t rect);
 
   void update();
   void click(int16_t x, uint8_t button) const;
-  auto get_event_handler() -> events_t* { return &_events; }
+  void move_resize(rectangle_t rect);
+  void expose(int16_t x, uint16_t width);
+  void set_hidden(hidden_e reason, bool hidden);
+
+  [[nodiscard]] rectangle_t rect() const { return _win.rect(); }
+  [[nodiscard]] xcb_window_t id() const { return _win.id(); }
 
  private:
   BarWindow _win;
-  events_t _events;
+  bool _dirty{false};  // updated while hidden
   Section<const Left&...> _left;
   Section<const Middle&...> _middle;
   Section<const Right&...> _right;
@@ -112,33 +129,26 @@ Bar(const BarBuilder<std::tuple<const Left&...>, std::tuple<const Middle&...>,
 template <typename... Left, typename... Middle, typename... Right>
 Bar<std::tuple<const Left&...>, std::tuple<const Middle&...>,
     std::tuple<const Right&...>>::
-    Bar(const BarBuilder<std::tuple<const Left&...>,
-                         std::tuple<const Middle&...>,
-                         std::tuple<const Right&...>>& builder)
-    : _win([&builder]() -> BarWindow {
+    Bar(const builder_t& builder, rectangle_t rect)
+    : _win([&builder, rect]() -> BarWindow {
       auto& ds = DS::Instance();
-      auto rdb = ds.create_resource_database();
-
-      auto fg = ds.create_font_color(rgba_t::parse(
-          builder._font_fg.from_rdb
-              ? rdb.get<std::string>(builder._font_fg.name).c_str()
-              : builder._font_fg.name));
-      auto acc = ds.create_font_color(rgba_t::parse(
-          builder._font_acc.from_rdb
-              ? rdb.get<std::string>(builder._font_acc.name).c_str()
-              : builder._font_acc.name));
+      auto lookup = [&ds](lookup_value_t value) {
+        return rgba_t::parse(value.from_rdb ? ds.get_resource(value.name).c_str()
+                                            : value.name);
+      };
 
       BarColors bar_colors{
-          .background =
-              rgba_t::parse(builder._bg.from_rdb
-                                ? rdb.get<std::string>(builder._bg.name).c_str()
-                                : builder._bg.name),
-          .foreground = fg,
-          .fg_accent = acc};
-
-      return BarWindow(std::move(bar_colors), builder._rect);
+          .background = lookup(builder._bg),
+          .foreground = ds.create_font_color(lookup(builder._font_fg)),
+          .fg_accent = ds.create_font_color(lookup(builder._font_acc))};
+      // without an urgent color urgent text is only accented
+      bar_colors.fg_urgent =
+          builder._font_urg.name != nullptr
+              ? ds.create_font_color(lookup(builder._font_urg))
+              : bar_colors.fg_accent;
+
+      return BarWindow(std::move(bar_colors), rect);
     }())
-    , _events(this)
     , _left(builder._padding, &_win, builder._left)
     , _middle(builder._padding, &_win, builder._middle)
     , _right(builder._padding, &_win, builder._right) {
@@ -149,6 +159,13 @@ template <typename... Left, typename... Middle, typename... Right>
 void
 Bar<std::tuple<const Left&...>, std::tuple<const Middle&...>,
     std::tuple<const Right&...>>::update() {
+  // nobody would see it, so don't even collect the modules
+  if (!_win.visible()) {
+    _dirty = true;
+    return;
+  }
+  _dirty = false;
+
   _win.reset();
 
   std::pair<uint16_t, uint16_t> p;
@@ -176,46 +193,275 @@ Bar<std::tuple<const Left&...>, std::tuple<const Middle&...>,
 }
 
 
-/** events_t
- * A taskable class to handle user interactions with the bar.
+template <typename... Left, typename... Middle, typename... Right>
+void
+Bar<std::tuple<const Left&...>, std::tuple<const Middle&...>,
+    std::tuple<const Right&...>>::move_resize(rectangle_t rect) {
+  const auto old = _win.rect();
+  if (old == rect) {
+    return;
+  }
+
+  _win.move_resize(rect);
+  if (old.width != rect.width || old.height != rect.height) {
+    _left.resize(&_win);
+    _middle.resize(&_win);
+    _right.resize(&_win);
+  }
+  update();
+}
+
+
+/** expose
+ * Redraw part of the bar from what was drawn last, without collecting the
+ * modules again.
  */
 template <typename... Left, typename... Middle, typename... Right>
-class Bar<std::tuple<const Left&...>, std::tuple<const Middle&...>,
-          std::tuple<const Right&...>>::events_t {
+void
+Bar<std::tuple<const Left&...>, std::tuple<const Middle&...>,
+    std::tuple<const Right&...>>::expose(int16_t x, uint16_t width) {
+  if (_win.visible() && !_dirty) {
+    _win.present(x, width);
+  }
+}
+
+
+/** set_hidden
+ * While a bar is hidden updates only mark it dirty. Once it can be seen again
+ * it is brought up to date.
+ */
+template <typename... Left, typename... Middle, typename... Right>
+void
+Bar<std::tuple<const Left&...>, std::tuple<const Middle&...>,
+    std::tuple<const Right&...>>::set_hidden(hidden_e reason, bool hidden) {
+  const bool was_visible = _win.visible();
+  _win.set_hidden(reason, hidden);
+  if (!was_visible && _win.visible() && _dirty) {
+    update();
+  }
+}
+
+
+/** Bars
+ * Maintains one Bar per monitor, following monitors as they are added, removed
+ * or reconfigured. Only the bars of monitors that changed are touched, so
+ * fonts, colors and module state outlive a hotplug.
+ *
+ * This is also the taskable handling the events of the bars' windows: clicks,
+ * exposures and changes in visibility, including a fullscreen window being
+ * active on a bar's monitor.
+ */
+template <typename Builder>
+class Bars {
  public:
-  explicit events_t(Bar* bar) : _bar(bar), _ds(DS::Instance()) {}
+  explicit Bars(const Builder& builder);
+
+  // Called after a click has been handled, so that its feedback can be drawn
+  // without waiting for the next frame.
+  void on_click(std::function<void()>&& callback) {
+    _on_click = std::move(callback);
+  }
+
+  void update();
   bool has_work();
-  void do_work() { _bar->click(_event_x, _event_button); }
+  void do_work();
 
  private:
-  Bar* _bar;
+  using bar_t = decltype(Bar(std::declval<const Builder&>()));
+
+  void reconfigure();
+  void update_fullscreen();
+  bar_t* find(xcb_window_t window);
+
+  const Builder& _builder;
   DS& _ds;
-  int16_t _event_x{0};
-  uint8_t _event_button{0};
+  std::vector<std::unique_ptr<bar_t>> _bars;
+  std::unique_ptr<xcb_generic_event_t, decltype(std::free)*> _event{
+      nullptr, std::free};
+  std::function<void()> _on_click;
 };
 
-template <typename... Left, typename... Middle, typename... Right>
+
+template <typename Builder>
+Bars<Builder>::Bars(const Builder& builder)
+    : _builder(builder), _ds(DS::Instance()) {
+  _ds.watch_monitors();
+  _ds.watch_window_state();
+  reconfigure();
+}
+
+
+template <typename Builder>
+void
+Bars<Builder>::update() {
+  for (auto& bar : _bars) {
+    bar->update();
+  }
+}
+
+
+template <typename Builder>
 bool
-Bar<std::tuple<const Left&...>, std::tuple<const Middle&...>,
-    std::tuple<const Right&...>>::events_t::has_work() {
+Bars<Builder>::has_work() {
   while (auto event = _ds.poll_for_event()) {
     // TODO: can we filter in the display server to only return these values
     // in the first place so we don't have to check every time?
-    if ((event->response_type & 0x7F) == XCB_BUTTON_PRESS) {
-      auto* press = reinterpret_cast<xcb_button_press_event_t*>(event.get());
-      _event_x = press->event_x;
-      _event_button = press->detail;
-      return true;
+    switch (event->response_type & 0x7F) {
+      case XCB_BUTTON_PRESS:
+      case XCB_EXPOSE:
+      case XCB_VISIBILITY_NOTIFY:
+      case XCB_MAP_NOTIFY:
+      case XCB_UNMAP_NOTIFY:
+        _event = std::move(event);
+        return true;
+      default:
+        if (_ds.is_monitor_change(*event) ||
+            _ds.is_window_state_change(*event)) {
+          _event = std::move(event);
+          return true;
+        }
     }
   }
   return false;
 }
 
 
-struct lookup_value_t {
-  const char* name = nullptr;
-  bool from_rdb = false;
-};
+template <typename Builder>
+void
+Bars<Builder>::do_work() {
+  const auto event = std::move(_event);
+  if (_ds.is_monitor_change(*event)) {
+    reconfigure();
+    return;
+  }
+  if (_ds.is_window_state_change(*event)) {
+    // the active window may have changed, so follow it
+    _ds.watch_window_state();
+    update_fullscreen();
+    return;
+  }
+
+  switch (event->response_type & 0x7F) {
+    case XCB_BUTTON_PRESS: {
+      auto* press = reinterpret_cast<xcb_button_press_event_t*>(event.get());
+      if (auto* bar = find(press->event)) {
+        bar->click(press->event_x, press->detail);
+        if (_on_click) {
+          _on_click();
+        }
+      }
+      break;
+    }
+    case XCB_EXPOSE: {
+      auto* expose = reinterpret_cast<xcb_expose_event_t*>(event.get());
+      if (auto* bar = find(expose->window)) {
+        bar->expose(static_cast<int16_t>(expose->x), expose->width);
+      }
+      break;
+    }
+    case XCB_VISIBILITY_NOTIFY: {
+      auto* visibility =
+          reinterpret_cast<xcb_visibility_notify_event_t*>(event.get());
+      if (auto* bar = find(visibility->window)) {
+        bar->set_hidden(HIDDEN_OBSCURED, visibility->state ==
+                                             XCB_VISIBILITY_FULLY_OBSCURED);
+      }
+      break;
+    }
+    case XCB_MAP_NOTIFY: {
+      auto* map = reinterpret_cast<xcb_map_notify_event_t*>(event.get());
+      if (auto* bar = find(map->window)) {
+        bar->set_hidden(HIDDEN_UNMAPPED, false);
+      }
+      break;
+    }
+    case XCB_UNMAP_NOTIFY: {
+      auto* unmap = reinterpret_cast<xcb_unmap_notify_event_t*>(event.get());
+      if (auto* bar = find(unmap->window)) {
+        bar->set_hidden(HIDDEN_UNMAPPED, true);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+
+template <typename Builder>
+auto
+Bars<Builder>::find(xcb_window_t window) -> bar_t* {
+  const auto bar = std::ranges::find_if(
+      _bars, [window](const auto& b) { return b->id() == window; });
+  return bar != _bars.end() ? bar->get() : nullptr;
+}
+
+
+/** update_fullscreen
+ * Hide the bars on the monitor of a fullscreen active window, and show the
+ * others.
+ */
+template <typename Builder>
+void
+Bars<Builder>::update_fullscreen() {
+  const auto area = _ds.get_fullscreen_area();
+  for (auto& bar : _bars) {
+    const auto rect = bar->rect();
+    const bool covered = area && area->x <= rect.x && area->y <= rect.y &&
+                         area->x + area->width >= rect.x + rect.width &&
+                         area->y + area->height >= rect.y + rect.height;
+    bar->set_hidden(HIDDEN_FULLSCREEN, covered);
+  }
+}
+
+
+/** reconfigure
+ * Match the bars to the current monitors. Bars already in place are kept as
+ * is, the remaining ones are moved to monitors without a bar, and bars are only
+ * created or destroyed when the number of monitors changed.
+ */
+template <typename Builder>
+void
+Bars<Builder>::reconfigure() {
+  std::vector<rectangle_t> areas;
+  for (const auto& monitor : _ds.get_monitors()) {
+    areas.push_back({.x = monitor.x,
+                     .y = monitor.y,
+                     .width = monitor.width,
+                     .height = _builder.height()});
+  }
+
+  std::vector<std::unique_ptr<bar_t>> bars(areas.size());
+  for (size_t i = 0; i < areas.size(); ++i) {
+    auto bar = std::ranges::find_if(_bars, [&](const auto& b) {
+      return b && b->rect() == areas[i];
+    });
+    if (bar != _bars.end()) {
+      bars[i] = std::move(*bar);
+    }
+  }
+
+  auto spare = _bars.begin();
+  for (size_t i = 0; i < areas.size(); ++i) {
+    if (bars[i]) {
+      continue;
+    }
+    spare = std::find_if(spare, _bars.end(),
+                         [](const auto& b) { return b != nullptr; });
+    if (spare != _bars.end()) {
+      bars[i] = std::move(*spare);
+      bars[i]->move_resize(areas[i]);
+    } else {
+      bars[i] = std::make_unique<bar_t>(_builder, areas[i]);
+      bars[i]->update();
+    }
+  }
+
+  // whatever is left belonged to monitors which are gone
+  _bars = std::move(bars);
+  update_fullscreen();
+  report_pixmap_usage();
+}
 
 
 /** BarBuilder
@@ -228,6 +474,7 @@ class BarBuilder<std::tuple<const L&...>, std::tuple<const M&...>,
   consteval BarBuilder() = default;
 
   consteval auto area(rectangle_t rect) const;
+  consteval auto height(uint16_t height) const;
   consteval auto padding(padding_t padding) const;
 
   consteval auto bg_bar_color(const char* str) const;
@@ -239,6 +486,9 @@ class BarBuilder<std::tuple<const L&...>, std::tuple<const M&...>,
   consteval auto acc_font_color(const char* str) const;
   consteval auto acc_font_color_from_rdb(const char* str) const;
 
+  consteval auto urg_font_color(const char* str) const;
+  consteval auto urg_font_color_from_rdb(const char* str) const;
+
   template <typename... Mods>
   consteval auto left(const Mods&... tup) const;
 
@@ -248,6 +498,8 @@ class BarBuilder<std::tuple<const L&...>, std::tuple<const M&...>,
   template <typename... Mods>
   consteval auto right(const Mods&... tup) const;
 
+  [[nodiscard]] constexpr uint16_t height() const { return _rect.height; }
+
  private:
   friend class Bar<std::tuple<const L&...>, std::tuple<const M&...>,
                    std::tuple<const R&...>>;
@@ -257,6 +509,7 @@ class BarBuilder<std::tuple<const L&...>, std::tuple<const M&...>,
   lookup_value_t _bg;
   lookup_value_t _font_fg;
   lookup_value_t _font_acc;
+  lookup_value_t _font_urg;
   std::tuple<const L&...> _left;
   std::tuple<const M&...> _middle;
   std::tuple<const R&...> _right;
@@ -265,6 +518,7 @@ class BarBuilder<std::tuple<const L&...>, std::tuple<const M&...>,
   consteval explicit BarBuilder(rectangle_t rect, padding_t padding,
                                 lookup_value_t bg, lookup_value_t font_fg,
                                 lookup_value_t font_acc,
+                                lookup_value_t font_urg,
                                 std::tuple<const L&...> left,
                                 std::tuple<const M&...> middle,
                                 std::tuple<const R&...> right);
@@ -276,6 +530,7 @@ class BarBuilder<std::tuple<const L&...>, std::tuple<const M&...>,
 /* template <typename... L, typename... M, typename... R> */
 /* BarBuilder(rectangle_t rect, padding_t padding, lookup_value_t bg, */
 /*            lookup_value_t font_fg, lookup_value_t font_acc, */
+/*            lookup_value_t font_urg, */
 /*            std::tuple<const L&...> left, std::tuple<const M&...> middle, */
 /*            std::tuple<const R&...> right) */
 /*     -> BarBuilder<std::tuple<const L&...>, std::tuple<const M&...>, */
@@ -291,6 +546,7 @@ consteval BarBuilder<
                                          lookup_value_t bg,
                                          lookup_value_t font_fg,
                                          lookup_value_t font_acc,
+                                         lookup_value_t font_urg,
                                          std::tuple<const L&...> left,
                                          std::tuple<const M&...> middle,
                                          std::tuple<const R&...> right)
@@ -299,6 +555,7 @@ consteval BarBuilder<
     , _bg(bg)
     , _font_fg(font_fg)
     , _font_acc(font_acc)
+    , _font_urg(font_urg)
     , _left(left)
     , _middle(middle)
     , _right(right) {
@@ -311,42 +568,61 @@ consteval BarBuilder<
                             std::tuple<const R&...>>
 
 BAR_BUILDER_FUNC::area(rectangle_t rect) const {
-  return BarBuilder(rect, _padding, _bg, _font_fg, _font_acc, _left, _middle,
-                    _right);
+  return BarBuilder(rect, _padding, _bg, _font_fg, _font_acc, _font_urg, _left,
+                    _middle, _right);
+}
+
+BAR_BUILDER_FUNC::height(uint16_t height) const {
+  return BarBuilder({.x = _rect.x, .y = _rect.y, .width = _rect.width,
+                     .height = height},
+                    _padding, _bg, _font_fg, _font_acc, _font_urg, _left,
+                    _middle, _right);
 }
 
 BAR_BUILDER_FUNC::padding(padding_t padding) const {
-  return BarBuilder(_rect, padding, _bg, _font_fg, _font_acc, _left, _middle,
-                    _right);
+  return BarBuilder(_rect, padding, _bg, _font_fg, _font_acc, _font_urg, _left,
+                    _middle, _right);
 }
 
 BAR_BUILDER_FUNC::bg_bar_color(const char* str) const {
   return BarBuilder(_rect, _padding, {.name = str, .from_rdb = false}, _font_fg,
-                    _font_acc, _left, _middle, _right);
+                    _font_acc, _font_urg, _left, _middle, _right);
 }
 
 BAR_BUILDER_FUNC::bg_bar_color_from_rdb(const char* str) const {
   return BarBuilder(_rect, _padding, {.name = str, .from_rdb = true}, _font_fg,
-                    _font_acc, _left, _middle, _right);
+                    _font_acc, _font_urg, _left, _middle, _right);
 }
 
 BAR_BUILDER_FUNC::fg_font_color(const char* str) const {
   return BarBuilder(_rect, _padding, _bg, {.name = str, .from_rdb = false},
-                    _font_acc, _left, _middle, _right);
+                    _font_acc, _font_urg, _left, _middle, _right);
 }
 
 BAR_BUILDER_FUNC::fg_font_color_from_rdb(const char* str) const {
   return BarBuilder(_rect, _padding, _bg, {.name = str, .from_rdb = true},
-                    _font_acc, _left, _middle, _right);
+                    _font_acc, _font_urg, _left, _middle, _right);
 }
 
 BAR_BUILDER_FUNC::acc_font_color(const char* str) const {
   return BarBuilder(_rect, _padding, _bg, _font_fg,
-                    {.name = str, .from_rdb = false}, _left, _middle, _right);
+                    {.name = str, .from_rdb = false}, _font_urg, _left, _middle,
+                    _right);
 }
 
 BAR_BUILDER_FUNC::acc_font_color_from_rdb(const char* str) const {
   return BarBuilder(_rect, _padding, _bg, _font_fg,
+                    {.name = str, .from_rdb = true}, _font_urg, _left, _middle,
+                    _right);
+}
+
+BAR_BUILDER_FUNC::urg_font_color(const char* str) const {
+  return BarBuilder(_rect, _padding, _bg, _font_fg, _font_acc,
+                    {.name = str, .from_rdb = false}, _left, _middle, _right);
+}
+
+BAR_BUILDER_FUNC::urg_font_color_from_rdb(const char* str) const {
+  return BarBuilder(_rect, _padding, _bg, _font_fg, _font_acc,
                     {.name = str, .from_rdb = true}, _left, _middle, _right);
 }
 
@@ -360,17 +636,20 @@ BAR_BUILDER_FUNC::acc_font_color_from_rdb(const char* str) const {
 BAR_BUILDER_SECTION_FUNC::left(const Mods&... tup) const {
   return BarBuilder<std::tuple<const Mods&...>, std::tuple<const M&...>,
                     std::tuple<const R&...>>(
-      _rect, _padding, _bg, _font_fg, _font_acc, {tup...}, _middle, _right);
+      _rect, _padding, _bg, _font_fg, _font_acc, _font_urg, {tup...}, _middle,
+      _right);
 }
 
 BAR_BUILDER_SECTION_FUNC::middle(const Mods&... tup) const {
   return BarBuilder<std::tuple<const L&...>, std::tuple<const Mods&...>,
                     std::tuple<const R&...>>(
-      _rect, _padding, _bg, _font_fg, _font_acc, _left, {tup...}, _right);
+      _rect, _padding, _bg, _font_fg, _font_acc, _font_urg, _left, {tup...},
+      _right);
 }
 
 BAR_BUILDER_SECTION_FUNC::right(const Mods&... tup) const {
   return BarBuilder<std::tuple<const L&...>, std::tuple<const M&...>,
                     std::tuple<const Mods&...>>(
-      _rect, _padding, _bg, _font_fg, _font_acc, _left, _middle, {tup...});
+      _rect, _padding, _bg, _font_fg, _font_acc, _font_urg, _left, _middle,
+      {tup...});
 }
@@ -0,0 +1,147 @@
+/** ring_bench
+ * Throughput of publishing frames through limebar_ring.h, compared to writing
+ * every frame to a socket. The consumer mimics mod_ring: it asks for the
+ * doorbell, waits on it and reads the newest frame, at most once per simulated
+ * frame interval.
+ *
+ *   usage: ring_bench [frames] [frame interval in microseconds]
+ */
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "../limebar_ring.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+
+static void
+fill_frame(limebar_frame* frame, uint64_t i) {
+  std::array<char, 32> level;
+  const int length = snprintf(level.data(), level.size(), "%3d%%",
+                              static_cast<int>(i % 101));
+  limebar_frame_add(frame, "vol ", 4, LIMEBAR_NORMAL, 1);
+  limebar_frame_add(frame, level.data(), static_cast<uint16_t>(length),
+                    LIMEBAR_ACCENT, 0);
+}
+
+
+static void
+bench_ring(uint64_t frames, std::chrono::microseconds interval) {
+  auto ring = std::make_unique<limebar_ring>();
+  ring->magic = LIMEBAR_RING_MAGIC;
+  ring->version = LIMEBAR_RING_VERSION;
+  ring->slots = LIMEBAR_RING_SLOTS;
+  const int doorbell = eventfd(0, 0);
+
+  std::atomic<bool> done{false};
+  uint64_t wakeups = 0;
+  uint64_t read_frames = 0;
+  std::thread consumer([&] {
+    uint64_t seen = 0;
+    std::string text;
+    while (true) {
+      __atomic_store_n(&ring->armed, 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == seen) {
+        if (done) {
+          return;
+        }
+        uint64_t count;
+        if (read(doorbell, &count, sizeof(count)) != sizeof(count)) {
+          return;
+        }
+        ++wakeups;
+      }
+
+      const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+      const limebar_frame& frame =
+          ring->frames[(head - 1) % LIMEBAR_RING_SLOTS];
+      const uint64_t sequence =
+          __atomic_load_n(&frame.sequence, __ATOMIC_ACQUIRE);
+      text.assign(frame.text,
+                  std::min(frame.text_length, LIMEBAR_FRAME_TEXT));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (sequence == 2 * head &&
+          __atomic_load_n(&frame.sequence, __ATOMIC_RELAXED) == sequence) {
+        seen = head;
+        ++read_frames;
+      }
+      std::this_thread::sleep_for(interval);
+    }
+  });
+
+  const auto start = bench_clock::now();
+  for (uint64_t i = 0; i < frames; ++i) {
+    limebar_frame* frame = limebar_ring_begin(ring.get());
+    fill_frame(frame, i);
+    limebar_ring_commit(ring.get(), frame, doorbell);
+  }
+  const auto elapsed = bench_clock::now() - start;
+
+  done = true;
+  const uint64_t one = 1;
+  write(doorbell, &one, sizeof(one));
+  consumer.join();
+  close(doorbell);
+
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  printf("ring:   %.1f Mframes/s, %.1f ns/frame, %lu doorbells, %lu frames "
+         "read\n",
+         static_cast<double>(frames) / seconds / 1e6,
+         seconds * 1e9 / static_cast<double>(frames), wakeups, read_frames);
+}
+
+
+static void
+bench_socket(uint64_t frames) {
+  std::array<int, 2> pair;
+  socketpair(AF_UNIX, SOCK_STREAM, 0, pair.data());
+
+  std::thread consumer([fd = pair[1]] {
+    std::array<char, 64 * 1024> buffer;
+    while (read(fd, buffer.data(), buffer.size()) > 0) {
+    }
+  });
+
+  auto frame = std::make_unique<limebar_frame>();
+  const auto start = bench_clock::now();
+  for (uint64_t i = 0; i < frames; ++i) {
+    frame->run_count = 0;
+    frame->text_length = 0;
+    fill_frame(frame.get(), i);
+    const uint32_t size = frame->text_length;
+    write(pair[0], &size, sizeof(size));
+    write(pair[0], frame->text, size);
+  }
+  const auto elapsed = bench_clock::now() - start;
+
+  close(pair[0]);
+  consumer.join();
+  close(pair[1]);
+
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  printf("socket: %.1f Mframes/s, %.1f ns/frame\n",
+         static_cast<double>(frames) / seconds / 1e6,
+         seconds * 1e9 / static_cast<double>(frames));
+}
+
+
+int
+main(int argc, char** argv) {
+  const uint64_t frames = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+  const std::chrono::microseconds interval(
+      argc > 2 ? strtoll(argv[2], nullptr, 10) : 8000);
+
+  bench_ring(frames, interval);
+  bench_socket(frames);
+}
@@ -0,0 +1,137 @@
+/** script_bench
+ * Cost of running script modules. First the time to spawn a command with
+ * posix_spawn (as mod_script does) compared to fork and exec, while the parent
+ * has `ballast` MiB of memory mapped. Then 20 scripts are run at 1 s intervals
+ * as the bar would, counting how many module updates the output diffing lets
+ * through. Two of the scripts print the time, the others a fixed string.
+ *
+ *   usage: script_bench [spawns] [ballast in MiB] [seconds]
+ */
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../subprocess.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+
+static double
+micros_since(bench_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(bench_clock::now() - start)
+      .count();
+}
+
+
+static void
+bench_spawn(int spawns) {
+  auto start = bench_clock::now();
+  for (int i = 0; i < spawns; ++i) {
+    if (auto child = spawn_shell("exit 0")) {
+      reap_child(*child);
+    }
+  }
+  printf("posix_spawn: %.1f us/command\n", micros_since(start) / spawns);
+
+  start = bench_clock::now();
+  for (int i = 0; i < spawns; ++i) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+      execl("/bin/sh", "sh", "-c", "exit 0", nullptr);
+      _exit(127);
+    }
+    waitpid(pid, nullptr, 0);
+  }
+  printf("fork + exec: %.1f us/command\n", micros_since(start) / spawns);
+}
+
+
+static void
+bench_modules(int seconds) {
+  constexpr size_t count = 20;
+  std::array<std::string, count> commands;
+  for (size_t i = 0; i < count; ++i) {
+    commands[i] = i < 2 ? "date +%s" : "echo module " + std::to_string(i);
+  }
+  std::array<std::string, count> shown;
+
+  size_t spawned = 0;
+  size_t updates = 0;
+  size_t frames = 0;
+  double slowest = 0;
+  std::array<char, 4096> chunk;
+
+  for (int tick = 0; tick < seconds; ++tick) {
+    const auto start = bench_clock::now();
+    std::vector<child_t> children;
+    std::vector<pollfd> fds;
+    std::array<std::string, count> output;
+    for (size_t i = 0; i < count; ++i) {
+      if (auto child = spawn_shell(commands[i].c_str())) {
+        children.push_back(*child);
+        fds.push_back({.fd = child->output, .events = POLLIN, .revents = 0});
+        ++spawned;
+      }
+    }
+
+    // read every pipe until EOF
+    size_t open = fds.size();
+    while (open > 0) {
+      poll(fds.data(), fds.size(), -1);
+      for (size_t i = 0; i < fds.size(); ++i) {
+        if (fds[i].fd == -1 || fds[i].revents == 0) {
+          continue;
+        }
+        const ssize_t n = read(fds[i].fd, chunk.data(), chunk.size());
+        if (n > 0) {
+          output[i].append(chunk.data(), static_cast<size_t>(n));
+        } else if (n == 0) {
+          fds[i].fd = -1;
+          --open;
+        }
+      }
+    }
+
+    size_t changed = 0;
+    for (size_t i = 0; i < children.size(); ++i) {
+      reap_child(children[i]);
+      if (output[i] != shown[i]) {
+        shown[i] = output[i];
+        ++changed;
+      }
+    }
+    updates += changed;
+    frames += changed > 0 ? 1 : 0;
+    slowest = std::max(slowest, micros_since(start));
+
+    std::this_thread::sleep_until(start + std::chrono::seconds(1));
+  }
+
+  printf("%zu scripts for %d s: %zu commands, slowest round %.0f us\n", count,
+         seconds, spawned, slowest);
+  printf("module updates: %zu without diffing, %zu with\n", spawned, updates);
+  printf("redraws: %zu (at most one per round)\n", frames);
+}
+
+
+int
+main(int argc, char** argv) {
+  const int spawns = argc > 1 ? atoi(argv[1]) : 1000;
+  const size_t ballast = argc > 2 ? strtoull(argv[2], nullptr, 10) : 256;
+  const int seconds = argc > 3 ? atoi(argv[3]) : 5;
+
+  // touch the ballast so that fork has page tables to copy
+  std::vector<char> memory(ballast << 20U, 1);
+  bench_spawn(spawns);
+  bench_modules(seconds);
+  return memory[0] == 1 ? 0 : 1;
+}
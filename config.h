@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>  // size_t
 #include <string_view>
 
 #include "x.h"
@@ -8,6 +10,60 @@ constexpr bool FORCE_DOCK = false;
 constexpr const char* WM_NAME = nullptr;
 constexpr std::string_view WM_CLASS = "limebar";
 
+// named pipe that lemonbar formatted status lines are read from. When nullptr
+// they are read from stdin, unless it is a terminal.
+constexpr const char* LEMON_INPUT = nullptr;
+
+// name of the control socket in $XDG_RUNTIME_DIR, nullptr disables it
+constexpr const char* IPC_SOCKET = "limebar.sock";
+// how long to wait before accepting again when out of file descriptors
+constexpr std::chrono::milliseconds IPC_ACCEPT_BACKOFF{1000};
+
+// minimum time between two redraws of a bar
+constexpr std::chrono::milliseconds FRAME_INTERVAL{8};
+
+// timers due within the same window of this size are fired by one wakeup
+constexpr std::chrono::milliseconds TIMER_SLACK{50};
+
+// how often the cpu, load and memory modules sample /proc
+constexpr std::chrono::milliseconds SYSTEM_INTERVAL{2000};
+
+// how often the network module samples the interfaces' counters, backing off
+// up to the idle interval while there is no traffic
+constexpr std::chrono::milliseconds NETWORK_INTERVAL{1000};
+constexpr std::chrono::milliseconds NETWORK_IDLE_INTERVAL{8000};
+
+// how often batteries are re-read without having been notified of a change
+constexpr std::chrono::seconds BATTERY_FALLBACK{60};
+
+// number of threads available to modules which run asynchronously
+constexpr size_t WORKER_THREADS = 2;
+// how long an asynchronous module's refresh may take before the previous
+// content is kept up; the first paint waits on its initial content this long
+constexpr std::chrono::milliseconds ASYNC_MODULE_DEADLINE{50};
+
+// number of script module commands which may run at once, and how long each
+// may run before it is killed
+constexpr size_t SCRIPT_CONCURRENCY = 4;
+constexpr std::chrono::milliseconds SCRIPT_TIMEOUT{5000};
+// how often a command which closed its stdout is checked for having exited,
+// where the kernel can't notify us (no pidfd)
+constexpr std::chrono::milliseconds SCRIPT_REAP_INTERVAL{100};
+
+// how a bar is put on screen. BUFFERED composes the sections into a pixmap the
+// size of the bar which is then copied to the window, DIRECT copies each
+// section straight into the window, saving one bar wide copy per update. With
+// DIRECT a compositor may pick up an update halfway through.
+enum class present_mode_e { BUFFERED, DIRECT };
+constexpr present_mode_e PRESENT_MODE = present_mode_e::BUFFERED;
+
+// how text is drawn into the sections. XFT draws through Xft, SHM rasterizes
+// glyphs with FreeType on the client and uploads the result, through shared
+// memory when the server is local. GLYPHSET uploads each glyph to the server
+// once and draws a whole section with one request per color.
+enum class render_backend_e { XFT, SHM, GLYPHSET };
+constexpr render_backend_e RENDER_BACKEND = render_backend_e::XFT;
+
 // specify the display server to use. (currently only supports X)
 using DS = X11;
 
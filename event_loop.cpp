@@ -0,0 +1,271 @@
+#include "event_loop.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cppcoro/operation_cancelled.hpp>
+#include <cppcoro/sync_wait.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "x.h"
+
+
+static cppcoro::task<>
+guard(cppcoro::task<> task) {
+  try {
+    co_await std::move(task);
+  } catch (const cppcoro::operation_cancelled&) {
+    // the loop is shutting down
+  }
+}
+
+
+EventLoop::EventLoop(clock::duration timer_slack)
+    : _epoll(epoll_create1(EPOLL_CLOEXEC))
+    , _wake(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , _timers(timer_slack) {
+  if (_epoll == -1 || _wake == -1) {
+    std::cerr << "Couldn't create epoll instance\n";
+    exit(EXIT_FAILURE);
+  }
+
+  wake_on(_timers.fd());
+  wake_on(_wake);
+}
+
+/** ~EventLoop
+ * Wake every suspended coroutine with operation_cancelled so that they all
+ * unwind before the loop goes away.
+ */
+EventLoop::~EventLoop() {
+  _stopping = true;
+  while (!_fds.empty() || !_sleepers.empty() || !_properties.empty()) {
+    for (auto& [fd, waiter] : _fds) {
+      _ready.push_back(waiter);
+    }
+    for (auto& [waiter, id] : _sleepers) {
+      _timers.cancel(id);
+      _ready.push_back(waiter);
+    }
+    for (auto& [atom, waiter] : _properties) {
+      _ready.push_back(waiter);
+    }
+    _fds.clear();
+    _sleepers.clear();
+    _properties.clear();
+    do_work();
+  }
+  cppcoro::sync_wait(_scope.join());
+
+  if (_conn != nullptr) {
+    xcb_disconnect(_conn);
+  }
+  close(_wake);
+  close(_epoll);
+}
+
+void
+EventLoop::spawn(cppcoro::task<>&& task) {
+  _scope.spawn(guard(std::move(task)));
+}
+
+
+/** readable
+ * Completes once `fd` has data available to be read. Regular files and the
+ * like, e.g. /dev/null as stdin, can't be waited on but never block either,
+ * so they complete right away. Any other failure to wait is reported and
+ * cancels the awaiting coroutine.
+ */
+cppcoro::task<>
+EventLoop::readable(int fd) {
+  if (const int error = watch(fd); error == EPERM) {
+    std::cerr << "File descriptor " << fd
+              << " can't be waited on, reading it right away\n";
+    co_return;
+  } else if (error != 0) {
+    std::cerr << "Couldn't wait on file descriptor " << fd << ": "
+              << strerror(error) << '\n';
+    throw cppcoro::operation_cancelled();
+  }
+
+  waiter_t waiter;
+  _fds[fd] = &waiter;
+  co_await waiter.event;
+  throw_if_stopping();
+}
+
+cppcoro::task<>
+EventLoop::sleep_until(clock::time_point time) {
+  waiter_t waiter;
+  _sleepers[&waiter] = _timers.add(time, [this, waiter = &waiter] {
+    _sleepers.erase(waiter);
+    _ready.push_back(waiter);
+  });
+  co_await waiter.event;
+  throw_if_stopping();
+}
+
+cppcoro::task<>
+EventLoop::sleep_for(clock::duration duration) {
+  return sleep_until(clock::now() + duration);
+}
+
+/** property_change
+ * Completes on the next change of the root window property `atom`. Changes
+ * which happen while nothing is waiting on the property are not remembered.
+ */
+cppcoro::task<>
+EventLoop::property_change(xcb_atom_t atom) {
+  if (_conn == nullptr) {
+    _conn = get_connection();
+    uint32_t values = XCB_EVENT_MASK_PROPERTY_CHANGE;
+    xcb_screen_t* screen = xcb_setup_roots_iterator(xcb_get_setup(_conn)).data;
+    xcb_change_window_attributes(_conn, screen->root, XCB_CW_EVENT_MASK,
+                                 &values);
+    xcb_flush(_conn);
+
+    _conn_fd = xcb_get_file_descriptor(_conn);
+    wake_on(_conn_fd);
+  }
+
+  waiter_t waiter;
+  _properties.emplace(atom, &waiter);
+  co_await waiter.event;
+  throw_if_stopping();
+}
+
+
+void
+EventLoop::forget(int fd) {
+  if (auto itr = std::find(_watched.begin(), _watched.end(), fd);
+      itr != _watched.end()) {
+    epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    _watched.erase(itr);
+  }
+  _fds.erase(fd);
+}
+
+
+void
+EventLoop::wake_on(int fd) {
+  epoll_event event{.events = EPOLLIN, .data = {.fd = fd}};
+  epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event);
+}
+
+void
+EventLoop::wake() {
+  const uint64_t one = 1;
+  write(_wake, &one, sizeof(one));
+}
+
+
+void
+EventLoop::wait() {
+  if (!_ready.empty()) {
+    return;
+  }
+  int timeout_ms = -1;
+  if (auto wakeup = next_wakeup()) {
+    timeout_ms = static_cast<int>(
+        std::chrono::ceil<std::chrono::milliseconds>(
+            std::max<clock::duration>(*wakeup - clock::now(),
+                                      clock::duration::zero()))
+            .count());
+  }
+  dispatch(timeout_ms);
+}
+
+
+/** has_work
+ * Collect every coroutine whose event has occurred without blocking.
+ */
+bool
+EventLoop::has_work() {
+  dispatch(0);
+  return !_ready.empty();
+}
+
+void
+EventLoop::do_work() {
+  // resumed coroutines may immediately wait again, so work from a copy
+  std::vector<waiter_t*> ready;
+  std::swap(ready, _ready);
+  for (waiter_t* waiter : ready) {
+    waiter->event.set();
+  }
+}
+
+
+/** dispatch
+ * Wait up to `timeout_ms` for events and queue the coroutines waiting on them.
+ */
+void
+EventLoop::dispatch(int timeout_ms) {
+  std::array<epoll_event, 16> events;
+  int count = epoll_wait(_epoll, events.data(), events.size(), timeout_ms);
+  for (int i = 0; i < count; ++i) {
+    const int fd = events[i].data.fd;
+    if (fd == _timers.fd()) {
+      _timers.expire();
+    } else if (fd == _wake) {
+      uint64_t wakeups = 0;
+      read(_wake, &wakeups, sizeof(wakeups));
+    } else if (fd == _conn_fd) {
+      poll_properties();
+    } else if (auto itr = _fds.find(fd); itr != _fds.end()) {
+      _ready.push_back(itr->second);
+      _fds.erase(itr);
+    }
+  }
+}
+
+/** watch
+ * Arm `fd` for a single readiness notification. Returns 0, or the error if
+ * `fd` can't be watched.
+ */
+int
+EventLoop::watch(int fd) {
+  epoll_event event{.events = EPOLLIN | EPOLLONESHOT, .data = {.fd = fd}};
+  if (std::find(_watched.begin(), _watched.end(), fd) != _watched.end()) {
+    return epoll_ctl(_epoll, EPOLL_CTL_MOD, fd, &event) == 0 ? 0 : errno;
+  }
+  if (epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event) == -1) {
+    return errno;
+  }
+  _watched.push_back(fd);
+  return 0;
+}
+
+void
+EventLoop::poll_properties() {
+  while (true) {
+    std::unique_ptr<xcb_generic_event_t, decltype(std::free)*> ev{
+        xcb_poll_for_event(_conn), std::free};
+    if (!ev) {
+      return;
+    }
+    if ((ev->response_type & 0x7F) != XCB_PROPERTY_NOTIFY) {
+      continue;
+    }
+    auto atom = reinterpret_cast<xcb_property_notify_event_t*>(ev.get())->atom;
+    auto [begin, end] = _properties.equal_range(atom);
+    for (auto itr = begin; itr != end; ++itr) {
+      _ready.push_back(itr->second);
+    }
+    _properties.erase(begin, end);
+  }
+}
+
+void
+EventLoop::throw_if_stopping() const {
+  if (_stopping) {
+    throw cppcoro::operation_cancelled();
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <xcb/xcb.h>
+
+#include <chrono>
+#include <cppcoro/async_scope.hpp>
+#include <cppcoro/single_consumer_event.hpp>
+#include <cppcoro/task.hpp>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "timer_wheel.h"
+
+
+/** EventLoop
+ * Drives coroutine based modules. A coroutine co_awaits file descriptor
+ * readiness, a timer or an X property change and is only resumed by the loop
+ * once that event has occurred, so a module with nothing to do costs nothing.
+ *
+ * The loop itself is Taskable and is run from the main loop like any other
+ * task; coroutines are resumed from within do_work(). Timers are kept on one
+ * shared TimerWheel, which periodic modules can also register with directly.
+ *
+ * The main loop blocks in wait() until something is ready. Tasks which drain a
+ * file descriptor themselves, like the X connections, register it with
+ * wake_on(), and other threads wake the loop with wake().
+ */
+class EventLoop {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  explicit EventLoop(clock::duration timer_slack);
+  ~EventLoop();
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop(EventLoop&&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+  EventLoop& operator=(EventLoop&&) = delete;
+
+  // Start `task` immediately and run it until its first suspension. Its
+  // lifetime is then owned by the loop.
+  void spawn(cppcoro::task<>&& task);
+
+  // awaitables
+  [[nodiscard]] cppcoro::task<> readable(int fd);
+  [[nodiscard]] cppcoro::task<> sleep_until(clock::time_point time);
+  [[nodiscard]] cppcoro::task<> sleep_for(clock::duration duration);
+  [[nodiscard]] cppcoro::task<> property_change(xcb_atom_t atom);
+
+  // Stop watching `fd`. Must be called before closing a file descriptor that
+  // has been awaited on.
+  void forget(int fd);
+
+  // Return from wait() whenever `fd` is readable. Whoever owns `fd` has to
+  // drain it in its has_work(), nothing is resumed for it.
+  void wake_on(int fd);
+  // Return from wait(). May be called from any thread.
+  void wake();
+
+  [[nodiscard]] TimerWheel& timers() { return _timers; }
+  [[nodiscard]] auto next_wakeup() const -> std::optional<clock::time_point> {
+    return _timers.next_wakeup();
+  }
+
+  // Block until there is work or the next timer is due.
+  void wait();
+
+  bool has_work();
+  void do_work();
+
+ private:
+  struct waiter_t {
+    cppcoro::single_consumer_event event;
+  };
+
+  void dispatch(int timeout_ms);
+  int watch(int fd);
+  void poll_properties();
+  void throw_if_stopping() const;
+
+  int _epoll;
+  int _wake;  // eventfd written to by wake()
+  std::vector<int> _watched;
+  std::unordered_map<int, waiter_t*> _fds;
+  TimerWheel _timers;
+  std::unordered_map<waiter_t*, TimerWheel::timer_id> _sleepers;
+  std::unordered_multimap<xcb_atom_t, waiter_t*> _properties;
+
+  // connection only used to receive property changes on the root window
+  xcb_connection_t* _conn{nullptr};
+  int _conn_fd{-1};
+
+  std::vector<waiter_t*> _ready;
+  cppcoro::async_scope _scope;
+  bool _stopping{false};
+};
@@ -0,0 +1,192 @@
+#include "font_cache.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+
+static uint64_t
+hash(std::string_view str) {
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (char c : str) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static std::optional<int64_t>
+mtime(const char* file) {
+  struct stat st {};
+  if (stat(file, &st) != 0) {
+    return std::nullopt;
+  }
+  return (static_cast<int64_t>(st.st_mtim.tv_sec) * 1'000'000'000) +
+         st.st_mtim.tv_nsec;
+}
+
+static std::string
+cache_path() {
+  std::string dir;
+  if (const char* xdg = getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg) {
+    dir = xdg;
+  } else if (const char* home = getenv("HOME"); home != nullptr && *home) {
+    dir = std::string(home) + "/.cache";
+  } else {
+    return {};
+  }
+  mkdir(dir.c_str(), 0755);
+  dir += "/limebar";
+  mkdir(dir.c_str(), 0755);
+  return dir + "/fonts.cache";
+}
+
+
+FontCache::FontCache() : _map(MAP_FAILED) {
+  bool fresh = true;
+  if (auto path = cache_path(); !path.empty()) {
+    _fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    // the mapping is written without any further locking, so the file
+    // belongs to one bar at a time and the others use anonymous memory
+    if (_fd != -1 && flock(_fd, LOCK_EX | LOCK_NB) == 0) {
+      struct stat st {};
+      fstat(_fd, &st);
+      fresh = static_cast<size_t>(st.st_size) != SIZE;
+      if (!fresh || ftruncate(_fd, SIZE) == 0) {
+        _map = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+      }
+    }
+    // the lock is held for as long as the descriptor is open
+    if (_map == MAP_FAILED && _fd != -1) {
+      close(_fd);
+      _fd = -1;
+    }
+  }
+  if (_map == MAP_FAILED) {
+    fresh = true;
+    _map = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+
+  _header = static_cast<header_t*>(_map);
+  _chars = static_cast<uint8_t*>(_map) + sizeof(header_t);
+  _advances = reinterpret_cast<uint16_t*>(_chars + CHARS);
+
+  if (fresh || _header->magic != MAGIC || _header->version != VERSION ||
+      _header->font_count != FONTS.size()) {
+    reset();
+    return;
+  }
+
+  // a pattern that was edited in config_font.h invalidates its font
+  for (size_t i = 0; i < FONTS.size(); ++i) {
+    if (_header->fonts[i].pattern_hash != hash(FONTS[i])) {
+      reset_font(i);
+      std::fill_n(_chars, CHARS, NO_FONT);
+    }
+  }
+}
+
+FontCache::~FontCache() {
+  munmap(_map, SIZE);
+  if (_fd != -1) {
+    close(_fd);
+  }
+}
+
+
+auto
+FontCache::resolved(size_t font) const -> std::optional<std::string_view> {
+  const auto& entry = _header->fonts[font];
+  if (entry.resolved[0] == '\0' || mtime(entry.file) != entry.mtime) {
+    return std::nullopt;
+  }
+  return entry.resolved;
+}
+
+/** store
+ * Record what FONTS[font] resolved to. If it is no longer the font file the
+ * cache was built from, everything derived from it is dropped.
+ */
+void
+FontCache::store(size_t font, std::string_view resolved, const char* file) {
+  auto& entry = _header->fonts[font];
+  const auto file_mtime = mtime(file).value_or(-1);
+  // a path which doesn't fit is compared in the truncated form it is stored in
+  constexpr size_t max_file = sizeof(entry.file) - 1;
+  if (strncmp(entry.file, file, max_file) != 0 || entry.mtime != file_mtime) {
+    reset_font(font);
+    std::fill_n(_chars, CHARS, NO_FONT);
+    strncpy(entry.file, file, max_file);
+    entry.file[max_file] = '\0';
+    entry.mtime = file_mtime;
+  }
+
+  // Patterns which don't fit are resolved by fontconfig on every start, as are
+  // those of a truncated path, which resolved() couldn't check.
+  const size_t length = resolved.size() < sizeof(entry.resolved) &&
+                                strlen(file) <= max_file
+                            ? resolved.size()
+                            : 0;
+  std::copy_n(resolved.data(), length, entry.resolved);
+  entry.resolved[length] = '\0';
+}
+
+
+auto
+FontCache::font_of(uint16_t ch) const -> std::optional<size_t> {
+  if (_chars[ch] == NO_FONT) {
+    return std::nullopt;
+  }
+  return _chars[ch];
+}
+
+void
+FontCache::set_font_of(uint16_t ch, size_t font) {
+  _chars[ch] = static_cast<uint8_t>(font);
+}
+
+
+auto
+FontCache::advance(size_t font, uint16_t ch) const -> std::optional<uint16_t> {
+  const uint16_t advance = _advances[(font * CHARS) + ch];
+  if (advance == NO_ADVANCE) {
+    return std::nullopt;
+  }
+  return advance;
+}
+
+void
+FontCache::set_advance(size_t font, uint16_t ch, uint16_t advance) {
+  _advances[(font * CHARS) + ch] = advance;
+}
+
+
+void
+FontCache::reset() {
+  _header->magic = MAGIC;
+  _header->version = VERSION;
+  _header->font_count = FONTS.size();
+  _header->reserved = 0;
+  for (size_t i = 0; i < FONTS.size(); ++i) {
+    reset_font(i);
+  }
+  std::fill_n(_chars, CHARS, NO_FONT);
+}
+
+void
+FontCache::reset_font(size_t font) {
+  auto& entry = _header->fonts[font];
+  entry.pattern_hash = hash(FONTS[font]);
+  entry.mtime = -1;
+  entry.file[0] = '\0';
+  entry.resolved[0] = '\0';
+  std::fill_n(_advances + (font * CHARS), CHARS, NO_ADVANCE);
+}
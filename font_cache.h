@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "config_font.h"
+
+
+/** FontCache
+ * Persistent cache of font lookups, memory mapped from
+ * $XDG_CACHE_HOME/limebar/fonts.cache. It remembers what every pattern in FONTS
+ * resolved to, which font each character is drawn with and the advance of
+ * every glyph, so that a warm start neither runs fontconfig's matching nor
+ * queries Xft for every glyph before the first layout.
+ *
+ * A font's entry is keyed by its pattern and the mtime of the font file it
+ * resolved to. Replacing an entry discards the glyph advances of that font and
+ * the font choice of every character, since both may have changed with it.
+ * If the file can't be used, or another bar holds its lock, the cache silently
+ * lives in anonymous memory.
+ */
+class FontCache {
+ public:
+  FontCache();
+  ~FontCache();
+
+  FontCache(const FontCache&) = delete;
+  FontCache(FontCache&&) = delete;
+  FontCache& operator=(const FontCache&) = delete;
+  FontCache& operator=(FontCache&&) = delete;
+
+  // The fully resolved pattern cached for FONTS[font], if it is still valid.
+  [[nodiscard]] auto resolved(size_t font) const
+      -> std::optional<std::string_view>;
+  void store(size_t font, std::string_view resolved, const char* file);
+
+  [[nodiscard]] auto font_of(uint16_t ch) const -> std::optional<size_t>;
+  void set_font_of(uint16_t ch, size_t font);
+
+  [[nodiscard]] auto advance(size_t font, uint16_t ch) const
+      -> std::optional<uint16_t>;
+  void set_advance(size_t font, uint16_t ch, uint16_t advance);
+
+ private:
+  static constexpr uint32_t MAGIC = 0x4346424c;  // "LBFC"
+  static constexpr uint32_t VERSION = 1;
+  static constexpr size_t CHARS = UINT16_MAX + 1;
+  static constexpr uint8_t NO_FONT = UINT8_MAX;
+  static constexpr uint16_t NO_ADVANCE = UINT16_MAX;
+  static_assert(FONTS.size() < NO_FONT);
+
+  struct font_entry_t {
+    uint64_t pattern_hash;
+    int64_t mtime;
+    char file[512];
+    char resolved[2048];
+  };
+
+  struct header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t font_count;
+    uint32_t reserved;
+    font_entry_t fonts[FONTS.size()];
+  };
+
+  static constexpr size_t SIZE =
+      sizeof(header_t) + CHARS + (FONTS.size() * CHARS * sizeof(uint16_t));
+
+  void reset();
+  void reset_font(size_t font);
+
+  int _fd{-1};  // holds the lock on the cache file
+  void* _map;
+  header_t* _header;
+  uint8_t* _chars;
+  uint16_t* _advances;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <tuple>
+#include <utility>  // exchange
+
+#include "event_loop.h"
+#include "task.h"
+
+
+/** FrameScheduler
+ * Coalesces redraws. Tasks update the scheduler instead of the bars directly,
+ * and the scheduler updates each bar at most once per frame interval.
+ *
+ * The scheduler is meant to run after every task which updates it in each
+ * iteration of the main loop. An update after a quiet period is therefore
+ * drawn in the same iteration it was marked in, so isolated changes such as
+ * the feedback to a click are not delayed, while bursts (e.g. a window manager
+ * changing several properties at once) are folded into one frame. A frame
+ * which has to wait for the interval is woken up by an exact timer on the
+ * EventLoop, and input such as a click calls flush() to be drawn right away.
+ */
+template <Downstream... D>
+class FrameScheduler {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  explicit FrameScheduler(clock::duration interval, EventLoop* loop, D*... d)
+      : _interval(interval), _loop(loop), _downstream(d...) {}
+
+  FrameScheduler(const FrameScheduler&) = delete;
+  FrameScheduler(FrameScheduler&&) = delete;
+  FrameScheduler& operator=(const FrameScheduler&) = delete;
+  FrameScheduler& operator=(FrameScheduler&&) = delete;
+
+  ~FrameScheduler() {
+    if (_timer) {
+      _loop->timers().cancel(*_timer);
+    }
+  }
+
+  // Mark the downstream as dirty.
+  void update() {
+    _dirty = true;
+    if (!_timer && clock::now() < _next_frame) {
+      // nothing to do in the callback, the wakeup lets has_work() see the frame
+      _timer =
+          _loop->timers().add_exact(_next_frame, [this] { _timer.reset(); });
+    }
+  }
+
+  // Draw any pending changes now regardless of the frame interval.
+  void flush() {
+    if (_dirty) {
+      do_work();
+    }
+  }
+
+  [[nodiscard]] bool has_work() const {
+    return _dirty && clock::now() >= _next_frame;
+  }
+
+  void do_work() {
+    if (_timer) {
+      _loop->timers().cancel(*std::exchange(_timer, std::nullopt));
+    }
+    _dirty = false;
+    _next_frame = clock::now() + _interval;
+    std::apply([](D*... d) { ((d->update()), ...); }, _downstream);
+  }
+
+ private:
+  clock::duration _interval;
+  EventLoop* _loop;
+  clock::time_point _next_frame;
+  std::optional<TimerWheel::timer_id> _timer;
+  std::tuple<D*...> _downstream;
+  bool _dirty{false};
+};
@@ -0,0 +1,269 @@
+#include "ipc.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "config.h"
+#include "profiler.h"
+
+// anything longer is not a message we would understand
+static constexpr uint32_t max_message_size = 64 * 1024;
+
+
+IpcServer::IpcServer(std::initializer_list<mod_ipc*> modules,
+                     std::initializer_list<mod_ring*> rings)
+    : _modules(modules), _rings(rings) {
+}
+
+IpcServer::~IpcServer() {
+  if (_socket != -1) {
+    close(_socket);
+    unlink(_path.c_str());
+  }
+}
+
+
+/** start
+ * Create the socket and accept clients on `loop`. The bar works without it, so
+ * failing to create it is not fatal.
+ */
+void
+IpcServer::start(EventLoop* loop) {
+  const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+  if (IPC_SOCKET == nullptr || runtime_dir == nullptr) {
+    return;
+  }
+  _path = std::string(runtime_dir) + '/' + IPC_SOCKET;
+
+  sockaddr_un addr{.sun_family = AF_UNIX};
+  if (_path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "IPC socket path is too long: " << _path << '\n';
+    return;
+  }
+  std::copy(_path.begin(), _path.end(), addr.sun_path);
+
+  // the socket of a previous run may have been left behind, but one which is
+  // still accepted on belongs to another bar
+  if (in_use(addr)) {
+    std::cerr << "Another bar is listening on " << _path << '\n';
+    return;
+  }
+
+  _socket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (_socket == -1 ||
+      bind(_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 ||
+      ::listen(_socket, SOMAXCONN) == -1) {
+    std::cerr << "Couldn't listen on " << _path << ": " << strerror(errno)
+              << '\n';
+    if (_socket != -1) {
+      close(_socket);
+      _socket = -1;
+    }
+    return;
+  }
+
+  loop->spawn(listen(*loop));
+}
+
+
+/** in_use
+ * Whether a server accepts connections on `addr`. A socket nobody listens on
+ * any more refuses them and is removed, so that it can be bound again.
+ */
+bool
+IpcServer::in_use(const sockaddr_un& addr) {
+  const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (probe == -1) {
+    return false;
+  }
+  const int connected =
+      connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+  const int error = errno;
+  close(probe);
+
+  if (connected == 0) {
+    return true;
+  }
+  if (error == ECONNREFUSED) {
+    unlink(addr.sun_path);
+  }
+  return false;
+}
+
+
+/** listen
+ * Accept clients as they connect. When accepting fails for lack of
+ * descriptors the connection stays pending and the socket readable, so
+ * accepting is retried after a pause rather than right away.
+ */
+cppcoro::task<>
+IpcServer::listen(EventLoop& loop) {
+  bool reported = false;
+  while (true) {
+    co_await loop.readable(_socket);
+    while (true) {
+      const int fd = accept4(_socket, nullptr, nullptr,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd != -1) {
+        reported = false;
+        loop.spawn(serve(loop, fd));
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+
+      if (!reported) {
+        std::cerr << "Couldn't accept an IPC client: " << strerror(errno)
+                  << '\n';
+        reported = true;
+      }
+      co_await loop.sleep_for(IPC_ACCEPT_BACKOFF);
+    }
+  }
+}
+
+/** serve
+ * Handle the messages of one client until it disconnects. Everything which is
+ * available is read before any of it is handled, and the downstream is only
+ * notified once all complete messages have been handled.
+ */
+cppcoro::task<>
+IpcServer::serve(EventLoop& loop, int fd) {
+  std::string buffer;
+  std::array<char, 4096> chunk;
+  bool open = true;
+
+  while (open) {
+    co_await loop.readable(fd);
+
+    while (true) {
+      const ssize_t count = read(fd, chunk.data(), chunk.size());
+      if (count > 0) {
+        buffer.append(chunk.data(), static_cast<size_t>(count));
+        continue;
+      }
+      open = count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+                             errno == EINTR);
+      if (!open || errno != EINTR) {
+        break;
+      }
+    }
+
+    std::string_view pending(buffer);
+    while (pending.size() >= sizeof(uint32_t)) {
+      uint32_t size;
+      std::memcpy(&size, pending.data(), sizeof(size));
+      if (size > max_message_size) {
+        reply(fd, "error: message too long");
+        open = false;
+        break;
+      }
+      if (pending.size() < sizeof(size) + size) {
+        break;
+      }
+      handle(fd, pending.substr(sizeof(size), size));
+      pending.remove_prefix(sizeof(size) + size);
+    }
+    buffer.erase(0, buffer.size() - pending.size());
+  }
+
+  loop.forget(fd);
+  close(fd);
+}
+
+
+/** handle
+ * Apply a single message from the client on `fd`.
+ */
+void
+IpcServer::handle(int fd, std::string_view message) {
+  Profiler& profiler = Profiler::Instance();
+  profiler.count(counter_e::IPC_MESSAGES);
+
+  // split off the next space separated word
+  const auto next_word = [&message] {
+    const size_t end = std::min(message.find(' '), message.size());
+    const std::string_view word = message.substr(0, end);
+    message.remove_prefix(std::min(end + 1, message.size()));
+    return word;
+  };
+  const std::string_view command = next_word();
+
+  if (command == "set") {
+    const std::string_view name = next_word();
+    const auto mod = std::ranges::find_if(
+        _modules, [name](const mod_ipc* m) { return m->name() == name; });
+    if (mod == _modules.end()) {
+      reply(fd, "error: no such module");
+      return;
+    }
+    if ((*mod)->set(message)) {
+      _updated = true;
+    }
+  } else if (command == "ring") {
+    const std::string_view name = next_word();
+    const auto ring = std::ranges::find_if(
+        _rings, [name](const mod_ring* r) { return r->name() == name; });
+    if (ring == _rings.end()) {
+      reply(fd, "error: no such ring");
+      return;
+    }
+    reply(fd, "ok", {(*ring)->memory_fd(), (*ring)->doorbell_fd()});
+  } else if (command == "redraw") {
+    _updated = true;
+  } else if (command == "stats") {
+    std::string stats;
+    for (size_t i = 0; i < static_cast<size_t>(counter_e::COUNT); ++i) {
+      const auto counter = static_cast<counter_e>(i);
+      stats.append(Profiler::name(counter));
+      stats.push_back(' ');
+      stats.append(std::to_string(profiler.counter(counter)));
+      stats.push_back('\n');
+    }
+    reply(fd, stats);
+  } else {
+    reply(fd, "error: unknown command");
+  }
+}
+
+/** reply
+ * Send a message to the client on `fd`, passing it `fds` along with it. Replies
+ * are small, so a client which doesn't read them and lets its socket fill up
+ * just loses them.
+ */
+void
+IpcServer::reply(int fd, std::string_view message,
+                 std::initializer_list<int> fds) {
+  const auto size = static_cast<uint32_t>(message.size());
+  std::string frame(sizeof(size) + message.size(), '\0');
+  std::memcpy(frame.data(), &size, sizeof(size));
+  std::copy(message.begin(), message.end(), frame.begin() + sizeof(size));
+
+  iovec iov{.iov_base = frame.data(), .iov_len = frame.size()};
+  msghdr header{.msg_iov = &iov, .msg_iovlen = 1};
+
+  // room for the two descriptors of a ring
+  alignas(cmsghdr) std::array<char, CMSG_SPACE(2 * sizeof(int))> control{};
+  if (fds.size() > 0) {
+    header.msg_control = control.data();
+    header.msg_controllen = CMSG_SPACE(fds.size() * sizeof(int));
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), fds.begin(), fds.size() * sizeof(int));
+  }
+  sendmsg(fd, &header, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <sys/un.h>
+
+#include <cppcoro/task.hpp>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "event_loop.h"
+#include "modules/ipc.h"
+#include "modules/ring.h"
+
+
+/** IpcServer
+ * Lets external tools control a running bar through a Unix domain socket in
+ * $XDG_RUNTIME_DIR. Every message is framed by its length as a native endian
+ * uint32_t, followed by that many bytes of a command:
+ *
+ *   set <module> <text>  set the text of the mod_ipc called <module>
+ *   redraw               redraw the bars
+ *   stats                reply with the profiler's counters
+ *   ring <module>        reply "ok" with the memfd and doorbell of the
+ *                        mod_ring called <module> attached (SCM_RIGHTS)
+ *
+ * Replies use the same framing; errors are replied to with "error: ...".
+ *
+ * Clients are served by coroutines on the EventLoop. Every message that has
+ * arrived by the time a client is read is applied before the downstream is
+ * updated, so a batch of updates sent in one write is drawn in one frame.
+ */
+class IpcServer {
+ public:
+  explicit IpcServer(std::initializer_list<mod_ipc*> modules,
+                     std::initializer_list<mod_ring*> rings = {});
+  ~IpcServer();
+
+  IpcServer(const IpcServer&) = delete;
+  IpcServer(IpcServer&&) = delete;
+  IpcServer& operator=(const IpcServer&) = delete;
+  IpcServer& operator=(IpcServer&&) = delete;
+
+  void start(EventLoop* loop);
+
+  [[nodiscard]] bool has_work() const { return _updated; }
+  void do_work() { _updated = false; }
+
+ private:
+  static bool in_use(const sockaddr_un& addr);
+  cppcoro::task<> listen(EventLoop& loop);
+  cppcoro::task<> serve(EventLoop& loop, int fd);
+  void handle(int fd, std::string_view message);
+  static void reply(int fd, std::string_view message,
+                    std::initializer_list<int> fds = {});
+
+  std::vector<mod_ipc*> _modules;
+  std::vector<mod_ring*> _rings;
+  std::string _path;
+  int _socket{-1};
+  bool _updated{false};
+};
@@ -1,55 +1,105 @@
 #include <chrono>
-#include <thread>
 #include <tuple>
 
 #include "bars.h"
 #include "color.h"
 #include "config.h"
+#include "event_loop.h"
+#include "frame_scheduler.h"
+#include "ipc.h"
+#include "modules/battery.h"
 #include "modules/clock.h"
+#include "modules/file.h"
 #include "modules/fill.h"
+#include "modules/ipc.h"
+#include "modules/lemon.h"
+#include "modules/network.h"
+#include "modules/ring.h"
+#include "modules/script.h"
+#include "modules/system.h"
 #include "modules/module.h"
 #include "modules/windows.h"
 #include "modules/workspaces.h"
+#include "modules/xkb.h"
+#include "profiler.h"
 #include "task.h"
+#include "thread_pool.h"
 
 int
 main() {
+  Profiler::Instance();
+
   static mod_workspaces workspaces;
   static mod_fill sep("|");
   static mod_windows windows;
   static mod_clock clock;
+  static mod_lemon input(LEMON_INPUT);
+  static mod_ipc status("status");
+  static mod_ring meter("meter");
+  static mod_cpu cpu(SYSTEM_INTERVAL);
+  static mod_load load(SYSTEM_INTERVAL);
+  static mod_memory memory(SYSTEM_INTERVAL);
+  static mod_battery battery;
+  static mod_network network;
+  static mod_xkb layout;
+  static mod_script kernel("uname -r");
+  static mod_file files({"/tmp/limebar/status"});
 
-  constexpr auto builder =
+  static constexpr auto builder =
       BarBuilderHelper()
+          .height(20)
           .padding({.start = 6, .end = 6, .inter_module = 0, .intra_module = 3})
           .bg_bar_color_from_rdb("background")
           .fg_font_color_from_rdb("foreground")
           .acc_font_color_from_rdb("color4")
-          .left(workspaces, sep, windows)
-          .middle(clock);
+          .urg_font_color_from_rdb("color1")
+          .left(workspaces, sep, windows, input.left)
+          .middle(clock, input.middle)
+          .right(input.right, status, files, meter, kernel, network, cpu,
+                 load, memory, battery, layout);
+
+  // one bar per monitor
+  Bars bars(builder);
 
-  constexpr size_t W = 1920;
-  constexpr size_t H = 20;
-  Bar l(builder.area({.x = 0,     .y = 0, .width = W, .height = H}));
-  Bar m(builder.area({.x = W,     .y = 0, .width = W, .height = H}));
-  Bar r(builder.area({.x = W * 2, .y = 0, .width = W, .height = H}));
+  ThreadPool pool(WORKER_THREADS);
+  EventLoop loop(TIMER_SLACK);
+  FrameScheduler frames(FRAME_INTERVAL, &loop, &bars);
+  bars.on_click([&frames] { frames.flush(); });
+  IpcServer ipc({&status}, {&meter});
+
+  // the X connections are drained by the tasks' has_work()
+  loop.wake_on(DS::Instance().fd());
+  loop.wake_on(workspaces.fd());
+  loop.wake_on(windows.fd());
+  loop.wake_on(layout.fd());
 
   std::tuple tasks{
-      ModuleTask(&workspaces, &l, &m, &r),
-      ModuleTask(&windows, &l, &m, &r),
-      ModuleTask(&clock, &l, &m, &r),
-      Task(l.get_event_handler()),
-      Task(m.get_event_handler()),
-      Task(r.get_event_handler())};
+      Task(&loop),
+      ModuleTask(&workspaces, &frames),
+      ModuleTask(&layout, &frames),
+      AsyncModuleTask(&pool, &loop, ASYNC_MODULE_DEADLINE, &windows,
+                      &frames),
+      CoroutineModuleTask(&loop, &clock, &frames),
+      CoroutineModuleTask(&loop, &input, &frames),
+      CoroutineModuleTask(&loop, &ipc, &frames),
+      CoroutineModuleTask(&loop, &meter, &frames),
+      CoroutineModuleTask(&loop, &cpu, &frames),
+      CoroutineModuleTask(&loop, &load, &frames),
+      CoroutineModuleTask(&loop, &memory, &frames),
+      CoroutineModuleTask(&loop, &network, &frames),
+      CoroutineModuleTask(&loop, &battery, &frames),
+      CoroutineModuleTask(&loop, &kernel, &frames),
+      CoroutineModuleTask(&loop, &files, &frames),
+      Task(&frames),
+      // last, so that events read while drawing are drained before waiting
+      Task(&bars)};
 
-  l.update();
-  m.update();
-  r.update();
+  wait_ready(tasks);
+  frames.update();
+  frames.flush();
 
   while (true) {
     std::apply([](auto&... task) { ((task.work()), ...); }, tasks);
-
-    // TODO: apply a better backoff heuristic. This is temporary.
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    loop.wait();
   }
 }
@@ -0,0 +1,120 @@
+/* limebar_ring.h
+ * Shared memory ring through which a single producer publishes the contents of
+ * a limebar module (see mod_ring) without a system call per update.
+ *
+ * A producer asks the control socket for "ring <module>" and receives two file
+ * descriptors with the reply: a memfd to be mapped shared with
+ * sizeof(struct limebar_ring) bytes, and an eventfd doorbell. Frames are
+ * written with limebar_ring_begin(), limebar_frame_add() and
+ * limebar_ring_commit(). The producer never waits: once the ring is full the
+ * oldest frame is overwritten, and the bar only ever reads the newest one. The
+ * doorbell is only rung when the bar has asked for it, so a producer updating
+ * faster than the bar draws makes a single system call per frame drawn.
+ *
+ * This header is C, so that producers don't need a C++ compiler.
+ */
+#ifndef LIMEBAR_RING_H
+#define LIMEBAR_RING_H
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LIMEBAR_RING_MAGIC 0x524d4c4cU /* "LLMR" */
+#define LIMEBAR_RING_VERSION 1U
+#define LIMEBAR_RING_SLOTS 16U
+#define LIMEBAR_FRAME_RUNS 16U
+#define LIMEBAR_FRAME_TEXT 1024U
+
+enum limebar_color { LIMEBAR_NORMAL = 0, LIMEBAR_ACCENT = 1 };
+
+/* A run of text in one color. A run which starts a segment begins a new
+ * clickable area and is separated from the previous one by padding. */
+struct limebar_run {
+  uint16_t offset; /* into limebar_frame.text */
+  uint16_t length;
+  uint8_t color; /* enum limebar_color */
+  uint8_t starts_segment;
+  uint8_t reserved[2];
+};
+
+struct limebar_frame {
+  /* Odd while the frame is written, otherwise twice its frame number. */
+  uint64_t sequence;
+  uint32_t run_count;
+  uint32_t text_length;
+  struct limebar_run runs[LIMEBAR_FRAME_RUNS];
+  char text[LIMEBAR_FRAME_TEXT];
+};
+
+struct limebar_ring {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slots;
+  uint32_t reserved;
+  /* The number of frames published so far. Only written by the producer. */
+  uint64_t head;
+  /* Set by the bar when it wants the doorbell rung on the next commit. */
+  uint32_t armed;
+  uint8_t padding[64 - 28];
+  struct limebar_frame frames[LIMEBAR_RING_SLOTS];
+};
+
+
+/* Returns non-zero if `ring` was set up by a compatible bar. */
+static inline int
+limebar_ring_check(const struct limebar_ring* ring) {
+  return ring->magic == LIMEBAR_RING_MAGIC &&
+         ring->version == LIMEBAR_RING_VERSION &&
+         ring->slots == LIMEBAR_RING_SLOTS;
+}
+
+/* Start writing the next frame. It is empty and not visible to the bar until
+ * it is committed. */
+static inline struct limebar_frame*
+limebar_ring_begin(struct limebar_ring* ring) {
+  const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  struct limebar_frame* frame = &ring->frames[head % LIMEBAR_RING_SLOTS];
+  __atomic_store_n(&frame->sequence, 2 * head + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  frame->run_count = 0;
+  frame->text_length = 0;
+  return frame;
+}
+
+/* Append `length` bytes of UTF-8 `text` to `frame`. Returns -1 if the frame is
+ * full, in which case it is left as it was. */
+static inline int
+limebar_frame_add(struct limebar_frame* frame, const char* text,
+                  uint16_t length, enum limebar_color color,
+                  int starts_segment) {
+  if (frame->run_count == LIMEBAR_FRAME_RUNS ||
+      frame->text_length + length > LIMEBAR_FRAME_TEXT) {
+    return -1;
+  }
+  struct limebar_run* run = &frame->runs[frame->run_count++];
+  run->offset = (uint16_t)frame->text_length;
+  run->length = length;
+  run->color = (uint8_t)color;
+  run->starts_segment = starts_segment != 0 || frame->run_count == 1;
+  memcpy(frame->text + frame->text_length, text, length);
+  frame->text_length += length;
+  return 0;
+}
+
+/* Publish `frame`, which has to be the frame returned by the last
+ * limebar_ring_begin(), and ring `doorbell` if the bar is waiting for it. */
+static inline void
+limebar_ring_commit(struct limebar_ring* ring, struct limebar_frame* frame,
+                    int doorbell) {
+  const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  __atomic_store_n(&frame->sequence, 2 * head + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_exchange_n(&ring->armed, 0, __ATOMIC_SEQ_CST) != 0) {
+    const uint64_t one = 1;
+    ssize_t written = write(doorbell, &one, sizeof(one));
+    (void)written;
+  }
+}
+
+#endif /* LIMEBAR_RING_H */
@@ -0,0 +1,197 @@
+#include "battery.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string_view>
+
+#include "../config.h"
+
+
+/** open_uevents
+ * A socket receiving the kernel's uevents, or -1 where they are not available
+ * (e.g. in some containers), in which case only the fallback timer is left.
+ */
+static int
+open_uevents() {
+  const int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        NETLINK_KOBJECT_UEVENT);
+  if (fd == -1) {
+    return -1;
+  }
+  sockaddr_nl addr{.nl_family = AF_NETLINK, .nl_pid = 0, .nl_groups = 1};
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// the value of a sysfs attribute without its newline
+static std::string_view
+attribute(proc_file_t& file) {
+  const std::string_view value = file.read();
+  return value.substr(0, value.find('\n'));
+}
+
+
+mod_battery::mod_battery(int uevents, const char* sysfs)
+    : _uevents(uevents == -1 ? open_uevents() : uevents)
+    , _power_supply(std::string(sysfs) + "/class/power_supply") {
+  if (_uevents == -1) {
+    std::cerr << "Couldn't listen to uevents, polling the batteries\n";
+    return;
+  }
+  // reading must not block the loop, even on a socket that was passed in
+  fcntl(_uevents, F_SETFL, fcntl(_uevents, F_GETFL) | O_NONBLOCK);
+}
+
+mod_battery::~mod_battery() {
+  if (_uevents != -1) {
+    close(_uevents);
+  }
+}
+
+
+/** run
+ * Read the batteries, then again every BATTERY_FALLBACK. Uevents are waited on
+ * by a second coroutine.
+ */
+cppcoro::task<>
+mod_battery::run(EventLoop& loop) {
+  render();
+  notify();
+  if (_uevents != -1) {
+    loop.spawn(watch_uevents(loop));
+  }
+
+  while (true) {
+    co_await loop.sleep_for(BATTERY_FALLBACK);
+    render();
+    notify();
+  }
+}
+
+cppcoro::task<>
+mod_battery::watch_uevents(EventLoop& loop) {
+  while (true) {
+    co_await loop.readable(_uevents);
+    if (read_uevents()) {
+      render();
+      notify();
+    }
+  }
+}
+
+
+/** read_uevents
+ * Drain the pending uevents. Returns whether any of them was about a power
+ * supply.
+ */
+bool
+mod_battery::read_uevents() {
+  bool changed = false;
+  while (true) {
+    // each message is "<action>@<devpath>\0KEY=value\0..."
+    const ssize_t count = read(_uevents, _message.data(), _message.size());
+    if (count <= 0) {
+      return changed;
+    }
+    const std::string_view message(_message.data(),
+                                   static_cast<size_t>(count));
+    if (message.find("SUBSYSTEM=power_supply") == std::string_view::npos) {
+      continue;
+    }
+    if (message.starts_with("add@") || message.starts_with("remove@")) {
+      _rescan = true;
+    }
+    changed = true;
+  }
+}
+
+/** render
+ * One segment per battery with its capacity, followed by a '+' while it is
+ * charging.
+ */
+void
+mod_battery::render() {
+  if (_rescan) {
+    scan();
+  }
+
+  _segments.resize(_batteries.size());
+  for (size_t i = 0; i < _batteries.size(); ++i) {
+    const std::string_view capacity = attribute(_batteries[i]->capacity);
+    const std::string_view status = attribute(_batteries[i]->status);
+
+    // the value is written into the string of the previous render
+    auto& seg = _segments[i];
+    if (seg.segments.size() != 2) {
+      seg = {.segments{{.str{"bat "}, .color = NORMAL_COLOR},
+                       {.str{}, .color = ACCENT_COLOR}},
+             .id = i};
+    }
+    auto& value = seg.segments[1].str;
+    value.assign(capacity);
+    value.push_back('%');
+    if (status == "Charging") {
+      value.push_back('+');
+    }
+  }
+}
+
+
+/** scan
+ * Find the batteries among the power supplies.
+ */
+void
+mod_battery::scan() {
+  _rescan = false;
+  _batteries.clear();
+
+  DIR* dir = opendir(_power_supply.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+  std::vector<std::string> supplies;
+  while (const dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      supplies.push_back(_power_supply + '/' + entry->d_name);
+    }
+  }
+  closedir(dir);
+  // keep BAT0 before BAT1
+  std::ranges::sort(supplies);
+
+  // a supply may go away at any point, one whose files can't be opened is
+  // skipped
+  const auto open_attribute = [](const std::string& supply, const char* name) {
+    return open((supply + '/' + name).c_str(), O_RDONLY | O_CLOEXEC);
+  };
+  for (const auto& supply : supplies) {
+    const int type = open_attribute(supply, "type");
+    if (type == -1) {
+      continue;
+    }
+    if (proc_file_t type_file(type); attribute(type_file) != "Battery") {
+      continue;
+    }
+
+    const int capacity = open_attribute(supply, "capacity");
+    const int status = open_attribute(supply, "status");
+    if (capacity == -1 || status == -1) {
+      for (const int fd : {capacity, status}) {
+        if (fd != -1) {
+          close(fd);
+        }
+      }
+      continue;
+    }
+    _batteries.push_back(std::make_unique<battery_t>(capacity, status));
+  }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cppcoro/task.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../event_loop.h"
+#include "../types.h"
+#include "module.h"
+#include "system.h"
+
+
+/** mod_battery
+ * Shows the charge of every battery. Instead of polling sysfs, it waits on the
+ * EventLoop for the kernel's power_supply uevents and only then re-reads the
+ * batteries' capacity and status. As not every change is announced, e.g. the
+ * capacity of some batteries, they are also re-read every BATTERY_FALLBACK.
+ *
+ * For testing, any socket delivering uevents in the kernel's format can be
+ * passed as `uevents`, and `sysfs` may point to a fake tree which contains
+ * class/power_supply.
+ */
+class mod_battery : public CoroutineModule<mod_battery> {
+  friend class CoroutineModule<mod_battery>;
+
+ public:
+  explicit mod_battery(int uevents = -1, const char* sysfs = "/sys");
+  ~mod_battery();
+
+  mod_battery(const mod_battery&) = delete;
+  mod_battery(mod_battery&&) = delete;
+  mod_battery& operator=(const mod_battery&) = delete;
+  mod_battery& operator=(mod_battery&&) = delete;
+
+  cppcoro::task<> run(EventLoop& loop);
+
+ private:
+  struct battery_t {
+    battery_t(int capacity_fd, int status_fd)
+        : capacity(capacity_fd), status(status_fd) {}
+
+    proc_file_t capacity;
+    proc_file_t status;
+  };
+
+  cppcoro::task<> watch_uevents(EventLoop& loop);
+  bool read_uevents();
+  void scan();
+  void render();
+
+  int _uevents;
+  std::string _power_supply;  // the class/power_supply directory
+  std::vector<std::unique_ptr<battery_t>> _batteries;
+  bool _rescan{true};  // whether a power supply was added or removed
+  std::array<char, 8192> _message;
+
+  std::vector<segment_t> _segments;
+};
@@ -9,21 +9,24 @@ constexpr static std::array<const char*, 12> months{
     "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
 };
 
-mod_clock::mod_clock() : _time(std::chrono::system_clock::now()) {
-}
-
-bool
-mod_clock::has_work() {
-  auto now = std::chrono::system_clock::now();
-  if ((now - _time) > std::chrono::minutes(1)) {
-    _time = now;
-    return true;
+/** run
+ * Refresh the clock and sleep until the start of the next minute.
+ */
+cppcoro::task<>
+mod_clock::run(EventLoop& loop) {
+  while (true) {
+    refresh();
+    notify();
+
+    auto now = std::chrono::system_clock::now();
+    auto next_minute =
+        std::chrono::floor<std::chrono::minutes>(now) + std::chrono::minutes(1);
+    co_await loop.sleep_for(next_minute - now);
   }
-  return false;
 }
 
 void
-mod_clock::do_work() {
+mod_clock::refresh() {
   // TODO: use chrono and formatting
   time_t t = time(nullptr);
   struct tm* local = localtime(&t);
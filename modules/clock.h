@@ -1,20 +1,19 @@
 #pragma once
 
 #include <array>
-#include <chrono>
+#include <cppcoro/task.hpp>
 
+#include "../event_loop.h"
 #include "module.h"
 
-class mod_clock : public DynamicModule<mod_clock> {
-  friend class DynamicModule<mod_clock>;
+class mod_clock : public CoroutineModule<mod_clock> {
+  friend class CoroutineModule<mod_clock>;
 
  public:
-  mod_clock();
-
-  bool has_work();
-  void do_work();
+  cppcoro::task<> run(EventLoop& loop);
 
  private:
+  void refresh();
+
   std::array<segment_t, 1> _segments;
-  std::chrono::time_point<std::chrono::system_clock> _time;
 };
@@ -0,0 +1,236 @@
+#include "file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+#include <utility>  // move
+
+
+mod_file::mod_file(std::initializer_list<const char*> paths)
+    : _inotify(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+  if (_inotify == -1) {
+    std::cerr << "Couldn't initialize inotify\n";
+    exit(EXIT_FAILURE);
+  }
+
+  for (const char* path : paths) {
+    const std::string_view full(path);
+    const size_t slash = full.rfind('/');
+    _files.push_back(
+        {.path = std::string(full),
+         .dir = std::string(slash == std::string_view::npos
+                                ? std::string_view(".")
+                                : full.substr(0, std::max<size_t>(slash, 1))),
+         .base = std::string(full.substr(slash + 1))});
+  }
+  for (auto& file : _files) {
+    watch(file);
+  }
+}
+
+mod_file::~mod_file() {
+  for (const auto& file : _files) {
+    if (file.fd != -1) {
+      close(file.fd);
+    }
+  }
+  close(_inotify);
+}
+
+
+cppcoro::task<>
+mod_file::run(EventLoop& loop) {
+  for (auto& file : _files) {
+    load(file, true);
+  }
+  render();
+  notify();
+
+  while (true) {
+    co_await loop.readable(_inotify);
+    if (read_events()) {
+      render();
+      notify();
+    }
+  }
+}
+
+/** watch
+ * Watch the directory of `file`, so that files which are replaced or don't
+ * exist yet are seen too. While the directory doesn't exist, its nearest
+ * existing parent is watched for the missing directory below it to appear.
+ */
+void
+mod_file::watch(file_t& file) {
+  static constexpr uint32_t dir_mask =
+      IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+  // a parent, e.g. /tmp, only has to announce the directory below it, and not
+  // every unrelated write
+  static constexpr uint32_t parent_mask = IN_CREATE | IN_MOVED_TO;
+
+  std::string dir = file.dir;
+  std::string name = file.base;
+  uint32_t mask = dir_mask;
+  int wd;
+  while (true) {
+    // a directory may be watched for several files, in either role
+    wd = inotify_add_watch(_inotify, dir.c_str(), mask | IN_MASK_ADD);
+    if (wd != -1 || (errno != ENOENT && errno != ENOTDIR) || dir == "/" ||
+        dir == ".") {
+      break;
+    }
+    mask = parent_mask;
+    const size_t slash = dir.rfind('/');
+    if (slash == std::string::npos) {
+      name = std::move(dir);
+      dir = ".";
+    } else {
+      name.assign(dir, slash + 1);
+      dir.resize(std::max<size_t>(slash, 1));
+    }
+  }
+  if (wd == -1) {
+    std::cerr << "Couldn't watch " << file.dir << '\n';
+  }
+
+  // the watch of a parent is no longer needed once nothing waits on it
+  const int previous = file.wd;
+  if (previous != -1 && previous != wd &&
+      std::ranges::none_of(_files, [&file, previous](const file_t& other) {
+        return &other != &file && other.wd == previous;
+      })) {
+    inotify_rm_watch(_inotify, previous);
+  }
+
+  file.wd = wd;
+  file.name = std::move(name);
+  file.parent = dir != file.dir;
+}
+
+/** read_events
+ * Re-read the files named by the pending events. Returns whether any of their
+ * lines changed.
+ */
+bool
+mod_file::read_events() {
+  bool changed = false;
+  while (true) {
+    const ssize_t count = read(_inotify, _events.data(), _events.size());
+    if (count <= 0) {
+      return changed;
+    }
+
+    for (ssize_t offset = 0; offset < count;) {
+      const auto* event =
+          reinterpret_cast<const inotify_event*>(_events.data() + offset);
+      offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+      if ((event->mask & IN_Q_OVERFLOW) != 0) {
+        changed |= reload();
+        continue;
+      }
+      if ((event->mask & IN_IGNORED) != 0) {
+        // the directory went away, wait for it to come back
+        for (auto& file : _files) {
+          if (file.wd == event->wd) {
+            file.wd = -1;
+            watch(file);
+          }
+        }
+        continue;
+      }
+      if (event->len == 0) {
+        continue;
+      }
+
+      const std::string_view name(event->name);
+      for (auto& file : _files) {
+        if (file.wd != event->wd || file.name != name) {
+          continue;
+        }
+        if (file.parent) {
+          // a directory on the way to the file appeared
+          if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+            watch(file);
+            changed |= load(file, true);
+          }
+        } else if ((event->mask & (IN_MOVED_FROM | IN_DELETE)) != 0) {
+          if (file.fd != -1) {
+            close(file.fd);
+            file.fd = -1;
+          }
+          changed |= !file.line.empty();
+          file.line.clear();
+        } else {
+          changed |= load(file, (event->mask & IN_MOVED_TO) != 0);
+        }
+      }
+    }
+  }
+}
+
+/** reload
+ * Watch and read every file again after events were lost. Returns whether any
+ * of their lines changed.
+ */
+bool
+mod_file::reload() {
+  bool changed = false;
+  for (auto& file : _files) {
+    watch(file);
+    changed |= load(file, true);
+  }
+  return changed;
+}
+
+/** load
+ * Read the first line of `file`, opening it again first if it might have been
+ * replaced. Returns whether the line changed.
+ */
+bool
+mod_file::load(file_t& file, bool reopen) {
+  if (reopen || file.fd == -1) {
+    if (file.fd != -1) {
+      close(file.fd);
+    }
+    file.fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+
+  std::string_view line;
+  if (file.fd != -1) {
+    const ssize_t count = pread(file.fd, _buffer.data(), _buffer.size(), 0);
+    line = {_buffer.data(), count > 0 ? static_cast<size_t>(count) : 0};
+    line = line.substr(0, line.find('\n'));
+  }
+  if (line == file.line) {
+    return false;
+  }
+  file.line.assign(line);
+  return true;
+}
+
+/** render
+ * One segment per file which has a line.
+ */
+void
+mod_file::render() {
+  // the segments are reused, so their strings keep their capacity
+  size_t count = 0;
+  for (const auto& file : _files) {
+    if (file.line.empty()) {
+      continue;
+    }
+    if (_segments.size() <= count) {
+      _segments.emplace_back();
+    }
+    auto& texts = _segments[count++].segments;
+    texts.resize(1);
+    texts[0].str.assign(file.line);
+    texts[0].color = NORMAL_COLOR;
+  }
+  _segments.resize(count);
+}
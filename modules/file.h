@@ -0,0 +1,68 @@
+#pragma once
+
+#include <sys/inotify.h>
+
+#include <array>
+#include <cppcoro/task.hpp>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "../event_loop.h"
+#include "../types.h"
+#include "module.h"
+
+
+/** mod_file
+ * Shows the first line of each of a set of files, for status sources which
+ * just write their value to a file, e.g. /run/user/1000/status/vpn. A file
+ * which doesn't exist or is empty isn't shown.
+ *
+ * The directories of the files are watched with inotify on the EventLoop, so
+ * nothing is polled. When a file is written (IN_CLOSE_WRITE) only that file is
+ * re-read, with a single pread on a descriptor which is kept open. One which
+ * is replaced (IN_MOVED_TO), as atomic writers do, is opened again first.
+ *
+ * While the directory of a file doesn't exist, its nearest existing parent is
+ * watched instead until the missing directory appears. When the inotify queue
+ * overflows every file is read again, as any of them may have changed.
+ */
+class mod_file : public CoroutineModule<mod_file> {
+  friend class CoroutineModule<mod_file>;
+
+ public:
+  explicit mod_file(std::initializer_list<const char*> paths);
+  ~mod_file();
+
+  mod_file(const mod_file&) = delete;
+  mod_file(mod_file&&) = delete;
+  mod_file& operator=(const mod_file&) = delete;
+  mod_file& operator=(mod_file&&) = delete;
+
+  cppcoro::task<> run(EventLoop& loop);
+
+ private:
+  struct file_t {
+    std::string path;
+    std::string dir;
+    std::string base;    // the name of the file within dir
+    std::string name;    // the entry of the watched directory waited on
+    bool parent{false};  // whether a parent of dir is watched
+    int wd{-1};
+    int fd{-1};
+    std::string line;
+  };
+
+  void watch(file_t& file);
+  bool read_events();
+  bool reload();
+  bool load(file_t& file, bool reopen);
+  void render();
+
+  int _inotify;
+  std::vector<file_t> _files;
+  std::array<char, 4096> _buffer;
+  alignas(inotify_event) std::array<char, 4096> _events;
+
+  std::vector<segment_t> _segments;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../types.h"
+#include "module.h"
+
+
+/** mod_ipc
+ * A module whose text is set by external tools through the control socket
+ * (see IpcServer), where it is addressed by `name`. It has no work of its own,
+ * the server updates the downstream for it.
+ */
+class mod_ipc : public DynamicModule<mod_ipc> {
+  friend class DynamicModule<mod_ipc>;
+
+ public:
+  explicit mod_ipc(const char* name) : _name(name) {}
+
+  [[nodiscard]] std::string_view name() const { return _name; }
+
+  // Returns whether the text changed.
+  bool set(std::string_view text) {
+    if (text.empty()) {
+      const bool changed = !_segments.empty();
+      _segments.clear();
+      return changed;
+    }
+    if (!_segments.empty() && _segments[0].segments[0].str == text) {
+      return false;
+    }
+    _segments.assign(
+        {{.segments{{.str = std::string(text), .color = NORMAL_COLOR}}}});
+    return true;
+  }
+
+ private:
+  const char* _name;
+  std::vector<segment_t> _segments;
+};
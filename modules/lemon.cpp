@@ -0,0 +1,372 @@
+#include "lemon.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+
+// anything longer is dropped rather than buffered until its newline arrives
+static constexpr size_t max_line_length = 64 * 1024;
+
+
+mod_lemon::mod_lemon(const char* fifo) {
+  if (fifo == nullptr) {
+    // a terminal isn't a producer, there is nothing to wait for
+    if (isatty(STDIN_FILENO) == 0) {
+      _fd = STDIN_FILENO;
+      fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+    }
+    return;
+  }
+
+  if (mkfifo(fifo, 0600) == -1 && errno != EEXIST) {
+    std::cerr << "Couldn't create the named pipe " << fifo << '\n';
+    exit(EXIT_FAILURE);
+  }
+  // also open it for writing so that the pipe never reaches EOF when a
+  // producer goes away
+  _fd = open(fifo, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (_fd == -1) {
+    std::cerr << "Couldn't open the named pipe " << fifo << '\n';
+    exit(EXIT_FAILURE);
+  }
+  _owned = true;
+}
+
+mod_lemon::~mod_lemon() {
+  if (_owned) {
+    close(_fd);
+  }
+}
+
+
+/** run
+ * Wait for input and redraw with the latest complete line it contains.
+ */
+cppcoro::task<>
+mod_lemon::run(EventLoop& loop) {
+  if (_fd == -1) {
+    co_return;
+  }
+
+  while (true) {
+    co_await loop.readable(_fd);
+    const bool open = drain();
+    if (_has_line) {
+      _has_line = false;
+      parse(_line);
+      notify();
+    }
+    if (!open) {
+      // keep showing the last line, as lemonbar does
+      loop.forget(_fd);
+      co_return;
+    }
+  }
+}
+
+/** drain
+ * Read everything that is available without blocking, keeping only the latest
+ * complete line. A line longer than max_line_length is dropped. Returns false
+ * once the input has been closed.
+ */
+bool
+mod_lemon::drain() {
+  while (true) {
+    const ssize_t count = read(_fd, _chunk.data(), _chunk.size());
+    if (count == 0) {
+      return false;
+    }
+    if (count == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    const std::string_view chunk(_chunk.data(), static_cast<size_t>(count));
+    const size_t last = chunk.rfind('\n');
+    if (last == std::string_view::npos) {
+      if (_pending.size() + chunk.size() > max_line_length) {
+        // not a status line, drop it up to its end
+        _pending.clear();
+        _overlong = true;
+      } else if (!_overlong) {
+        _pending.append(chunk);
+      }
+      continue;
+    }
+
+    // the line ending at `last` starts in this chunk or in _pending
+    const size_t start = chunk.rfind('\n', last == 0 ? 0 : last - 1);
+    if (start == std::string_view::npos || last == 0) {
+      if (!_overlong) {
+        _line.assign(_pending);
+        _line.append(chunk.substr(0, last));
+        _has_line = true;
+      }
+    } else {
+      _line.assign(chunk.substr(start + 1, last - start - 1));
+      _has_line = true;
+    }
+    _overlong = false;
+    _pending.assign(chunk.substr(last + 1));
+  }
+}
+
+
+/** parse
+ * Turn a line into the segments of the three regions in a single pass over
+ * views of it. The segments and commands of the previous line are reused, so
+ * text is copied straight from the line into them without any intermediate
+ * tokens.
+ */
+void
+mod_lemon::parse(std::string_view line) {
+  for (region_t* region : {&left, &middle, &right}) {
+    region->_used = 0;
+  }
+  _region = &left;
+  _color = NORMAL_COLOR;
+  _open = false;
+  _in_action = false;
+
+  while (!line.empty()) {
+    const size_t tag = line.find('%');
+    emit(line.substr(0, tag));
+    if (tag == std::string_view::npos) {
+      break;
+    }
+    line.remove_prefix(tag);
+
+    if (line.starts_with("%{")) {
+      line = parse_tags(line.substr(2));
+    } else if (line.starts_with("%%")) {
+      emit(line.substr(0, 1));
+      line.remove_prefix(2);
+    } else {
+      emit(line.substr(0, 1));
+      line.remove_prefix(1);
+    }
+  }
+  close_segment();
+}
+
+/** parse_tags
+ * Apply the space separated tags of one %{...} block and return what follows
+ * the block.
+ */
+std::string_view
+mod_lemon::parse_tags(std::string_view tags) {
+  while (!tags.empty()) {
+    const char tag = tags.front();
+    if (tag == '}') {
+      return tags.substr(1);
+    }
+
+    switch (tag) {
+      case ' ':
+        tags.remove_prefix(1);
+        continue;
+      case 'l':
+      case 'c':
+      case 'r':
+        _region = tag == 'l' ? &left : tag == 'c' ? &middle : &right;
+        _open = false;
+        _in_action = false;
+        break;
+      case 'F':
+        parse_color(tags.substr(0, tags.find_first_of(" }")));
+        break;
+      case 'B':
+        // the background is the bar's, so only resetting it is a no-op
+        if (!tags.starts_with("B-")) {
+          reject(tags, _rejected_background);
+        }
+        break;
+      case 'A':
+        tags = parse_action(tags.substr(1));
+        continue;
+      default:
+        break;
+    }
+
+    // skip the rest of the tag
+    const size_t end = tags.find_first_of(" }");
+    tags.remove_prefix(end == std::string_view::npos ? tags.size() : end);
+  }
+  return tags;
+}
+
+/** parse_color
+ * Apply %{F<color>}, `tag` starts at the 'F'. Modules only have the bar's
+ * colors, so these are selected by name and "-" selects the normal color again.
+ * Other colors can't be drawn and are rejected rather than drawn in a color the
+ * script didn't ask for.
+ */
+void
+mod_lemon::parse_color(std::string_view tag) {
+  const std::string_view color = tag.substr(1);
+  if (color == "-" || color == "normal") {
+    _color = NORMAL_COLOR;
+  } else if (color == "accent") {
+    _color = ACCENT_COLOR;
+  } else if (color == "urgent") {
+    _color = URGENT_COLOR;
+  } else {
+    reject(tag, _rejected_foreground);
+  }
+}
+
+/** reject
+ * Report a tag which isn't supported the first time it is seen. The tag
+ * doesn't change anything, the text after it is drawn as if it was missing.
+ */
+void
+mod_lemon::reject(std::string_view tag, bool& reported) {
+  if (reported) {
+    return;
+  }
+  reported = true;
+  const size_t end = tag.find_first_of(" }");
+  std::cerr << "mod_lemon: unsupported tag %{" << tag.substr(0, end)
+            << "}, ignoring it\n";
+}
+
+/** parse_action
+ * Parse %{A[button]:command:}, which starts a clickable area, or %{A}, which
+ * ends it. `tag` follows the 'A'. Colons in the command are escaped as "\:".
+ */
+std::string_view
+mod_lemon::parse_action(std::string_view tag) {
+  uint8_t button = 1;
+  if (!tag.empty() && tag.front() >= '1' && tag.front() <= '9') {
+    button = static_cast<uint8_t>(tag.front() - '0');
+    tag.remove_prefix(1);
+  }
+
+  _open = false;
+  if (!tag.starts_with(':')) {
+    _in_action = false;
+    return tag;
+  }
+  tag.remove_prefix(1);
+
+  // commands are kept by index so they can be reused like the segments
+  region_t& region = *_region;
+  if (region._commands.size() <= region._used) {
+    region._commands.resize(region._used + 1);
+  }
+  auto& command = region._commands[region._used];
+  command.str.clear();
+  command.button = button;
+
+  size_t i = 0;
+  for (; i < tag.size() && tag[i] != ':'; ++i) {
+    if (tag[i] == '\\' && i + 1 < tag.size() && tag[i + 1] == ':') {
+      ++i;
+    }
+    command.str.push_back(tag[i]);
+  }
+  _in_action = true;
+  return tag.substr(std::min(i + 1, tag.size()));
+}
+
+
+/** emit
+ * Append text in the current color to the current segment of the current
+ * region. The text entries of the segment are reused, so the text is assigned
+ * into their strings.
+ */
+void
+mod_lemon::emit(std::string_view text) {
+  if (text.empty()) {
+    return;
+  }
+  if (!_open) {
+    open_segment();
+  }
+
+  auto& texts = _region->_segments[_region->_used - 1].segments;
+  if (_texts > 0 && texts[_texts - 1].color == _color) {
+    texts[_texts - 1].str.append(text);
+    return;
+  }
+  if (texts.size() <= _texts) {
+    texts.emplace_back();
+  }
+  texts[_texts].str.assign(text);
+  texts[_texts].color = _color;
+  ++_texts;
+}
+
+/** open_segment
+ * Start the next segment of the current region. It is clickable if an action
+ * is open, with the action's command deciding what it does and its id.
+ */
+void
+mod_lemon::open_segment() {
+  close_segment();
+
+  region_t& region = *_region;
+  const size_t index = region._used++;
+  if (region._segments.size() < region._used) {
+    region._segments.resize(region._used);
+  }
+
+  auto& seg = region._segments[index];
+  seg.action.reset();
+  seg.id = 0;
+  _segment = &seg;
+
+  if (_in_action) {
+    // the command was stored at the index this segment ended up at
+    if (region._commands.size() <= index) {
+      region._commands.resize(index + 1);
+    }
+    const auto& command = region._commands[index];
+    seg.action = [&region, index](uint8_t button) {
+      const auto& cmd = region._commands[index];
+      if (button == cmd.button) {
+        std::cout << cmd.str << std::endl;
+      }
+    };
+    seg.id = std::hash<std::string>{}(command.str) ^ command.button;
+  }
+  _open = true;
+}
+
+/** close_segment
+ * Drop the text entries the last opened segment had left over from an earlier
+ * line.
+ */
+void
+mod_lemon::close_segment() {
+  if (_segment != nullptr) {
+    _segment->segments.resize(_texts);
+    _segment = nullptr;
+  }
+  _texts = 0;
+}
+
+
+cppcoro::generator<const segment_t&>
+mod_lemon::region_t::get() const {
+  for (size_t i = 0; i < _used; ++i) {
+    co_yield _segments[i];
+  }
+}
+
+cppcoro::generator<const segment_t&>
+mod_lemon::get() const {
+  for (const region_t* region : {&left, &middle, &right}) {
+    for (const auto& seg : region->get()) {
+      co_yield seg;
+    }
+  }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <cppcoro/generator.hpp>
+#include <cppcoro/task.hpp>
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../event_loop.h"
+#include "../types.h"
+#include "module.h"
+
+
+/** mod_lemon
+ * Reads status lines in lemonbar's format from stdin or a named pipe, so that
+ * scripts written for lemonbar can feed limebar. The left, middle and right
+ * parts of a line are exposed as the modules `left`, `middle` and `right`,
+ * which are placed in the sections of a bar like any other module.
+ *
+ * Only the latest complete line is drawn; lines which arrive faster than they
+ * are read are skipped. Supported tags are %{l}, %{c}, %{r}, %{F...} and
+ * %{A[button]:command:}...%{A}. Clicking an area prints its command to stdout
+ * like lemonbar does. Modules can only use the bar's colors, so %{Fnormal},
+ * %{Faccent} and %{Furgent} select one of them and %{F-} the normal color
+ * again. Other foreground colors and background colors other than %{B-} are
+ * reported once on stderr and ignored, as are the remaining tags.
+ */
+class mod_lemon : public CoroutineModule<mod_lemon> {
+ public:
+  // a part of the line drawn in one section
+  class region_t {
+   public:
+    cppcoro::generator<const segment_t&> get() const;
+
+   private:
+    friend class mod_lemon;
+
+    struct command_t {
+      std::string str;
+      uint8_t button{1};
+    };
+
+    // Segments and commands are reused from line to line, only the first
+    // `_used` of them are part of the current line.
+    std::vector<segment_t> _segments;
+    std::vector<command_t> _commands;
+    size_t _used{0};
+  };
+
+  // Read from the named pipe at `fifo`, which is created if it doesn't exist,
+  // or from stdin when nullptr.
+  explicit mod_lemon(const char* fifo = nullptr);
+  ~mod_lemon();
+
+  mod_lemon(const mod_lemon&) = delete;
+  mod_lemon(mod_lemon&&) = delete;
+  mod_lemon& operator=(const mod_lemon&) = delete;
+  mod_lemon& operator=(mod_lemon&&) = delete;
+
+  cppcoro::task<> run(EventLoop& loop);
+  cppcoro::generator<const segment_t&> get() const;
+
+  region_t left;
+  region_t middle;
+  region_t right;
+
+ private:
+  bool drain();
+  void parse(std::string_view line);
+  std::string_view parse_tags(std::string_view tags);
+  std::string_view parse_action(std::string_view tag);
+  void parse_color(std::string_view tag);
+  void reject(std::string_view tag, bool& reported);
+  void emit(std::string_view text);
+  void open_segment();
+  void close_segment();
+
+  int _fd{-1};
+  bool _owned{false};  // whether _fd has to be closed
+
+  std::array<char, 4096> _chunk;
+  std::string _pending;  // an incomplete line
+  std::string _line;     // the latest complete line
+  bool _has_line{false};
+  bool _overlong{false};  // whether the incomplete line is being dropped
+
+  // parser state
+  region_t* _region{&left};
+  font_color_e _color{NORMAL_COLOR};
+  bool _open{false};  // whether text goes into the last segment of _region
+  bool _in_action{false};
+  segment_t* _segment{nullptr};  // the segment text goes into
+  size_t _texts{0};              // the text entries of _segment in use
+
+  // whether an unsupported tag was reported already
+  bool _rejected_foreground{false};
+  bool _rejected_background{false};
+};
@@ -1,9 +1,15 @@
 #pragma once
 
 #include <cppcoro/generator.hpp>
+#include <chrono>
+#include <cppcoro/task.hpp>
+#include <cstddef>  // size_t
+#include <cstdint>
 #include <functional>
 #include <type_traits>
+#include <utility>  // swap
 
+#include "../event_loop.h"
 #include "../types.h"
 
 
@@ -30,3 +36,119 @@ class StaticModule {
     }
   }
 };
+
+
+/** AsyncModule
+ * A DynamicModule whose do_work() may run off of the render thread (see
+ * AsyncModuleTask). do_work() only ever writes to the module's `_segments`,
+ * which the task then publishes by swapping them with the snapshot that get()
+ * reads from. The render thread therefore always sees a complete set of
+ * segments, even while a newer one is being built.
+ */
+template <typename Mod, typename Segments>
+class AsyncModule {
+ public:
+  cppcoro::generator<const segment_t&> get() const {
+    for (const auto& seg : _snapshot) {
+      co_yield seg;
+    }
+  }
+
+  // Must only be called from the render thread while no do_work() is running.
+  void publish() { std::swap(_snapshot, static_cast<Mod&>(*this)._segments); }
+
+ private:
+  Segments _snapshot;
+};
+
+
+/** CoroutineModule
+ * A module written as a coroutine running on the EventLoop. The module defines
+ * `cppcoro::task<> run(EventLoop&)` which co_awaits whatever the module depends
+ * on and calls notify() whenever it has produced new segments. has_work() and
+ * do_work() only report those notifications so that the module can be driven
+ * by a plain Task, but nothing is computed in them.
+ */
+template <typename Mod>
+class CoroutineModule {
+ public:
+  cppcoro::generator<const segment_t&> get() const {
+    for (const auto& seg : static_cast<const Mod&>(*this)._segments) {
+      co_yield seg;
+    }
+  }
+
+  void start(EventLoop* loop) {
+    loop->spawn(static_cast<Mod&>(*this).run(*loop));
+  }
+
+  [[nodiscard]] bool has_work() const { return _notified; }
+  void do_work() { _notified = false; }
+
+ protected:
+  void notify() { _notified = true; }
+
+ private:
+  bool _notified{false};
+};
+
+
+/** PeriodicModule
+ * A DynamicModule which is refreshed every `interval` by a timer on the
+ * EventLoop's TimerWheel, so that periodic modules share wakeups. The module
+ * defines `void refresh()`, which is also run once when the module is started.
+ */
+template <typename Mod>
+class PeriodicModule : public DynamicModule<Mod> {
+ public:
+  explicit PeriodicModule(std::chrono::milliseconds interval)
+      : _interval(interval) {}
+
+  void start(EventLoop* loop) {
+    loop->timers().add(EventLoop::clock::now() + _interval, _interval,
+                       [this] { _due = true; });
+    _due = true;
+  }
+
+  [[nodiscard]] bool has_work() const { return _due; }
+  void do_work() {
+    _due = false;
+    static_cast<Mod&>(*this).refresh();
+  }
+
+ private:
+  std::chrono::milliseconds _interval;
+  bool _due{false};
+};
+
+
+/** fingerprint
+ * FNV-1a hash of everything about a module's segments that affects how they
+ * are drawn or behave: their text, colors and action identity.
+ */
+template <typename Mod>
+uint64_t
+fingerprint(const Mod& mod) {
+  uint64_t hash = 0xcbf29ce484222325U;
+  const auto add = [&hash](const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash = (hash ^ bytes[i]) * 0x100000001b3U;
+    }
+  };
+
+  for (const auto& seg : mod.get()) {
+    const size_t count = seg.segments.size();
+    add(&count, sizeof(count));
+    for (const auto& text : seg.segments) {
+      const size_t length = text.str.size();
+      add(&length, sizeof(length));
+      add(text.str.data(), length);
+      add(&text.color, sizeof(text.color));
+    }
+    const bool action = seg.action.has_value();
+    add(&action, sizeof(action));
+    add(&seg.id, sizeof(seg.id));
+  }
+  return hash;
+}
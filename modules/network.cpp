@@ -0,0 +1,273 @@
+#include "network.h"
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include "../config.h"
+
+
+/** format_rate
+ * A rate in bytes per second with at most four characters, e.g. "12K" or
+ * "1.5M".
+ */
+static std::string_view
+format_rate(std::array<char, 16>& buffer, double rate) {
+  static constexpr std::array<char, 5> units{'B', 'K', 'M', 'G', 'T'};
+  size_t unit = 0;
+  while (rate >= 1000 && unit + 1 < units.size()) {
+    rate /= 1024;
+    ++unit;
+  }
+  const int length =
+      rate < 10 && unit > 0
+          ? snprintf(buffer.data(), buffer.size(), "%.1f%c", rate, units[unit])
+          : snprintf(buffer.data(), buffer.size(), "%.0f%c", rate, units[unit]);
+  return {buffer.data(), length < 0 ? 0
+                                    : std::min(static_cast<size_t>(length),
+                                               buffer.size() - 1)};
+}
+
+// Returns whether `str` changed.
+static bool
+assign_if_changed(std::string& str, std::string_view value) {
+  if (str == value) {
+    return false;
+  }
+  str.assign(value);
+  return true;
+}
+
+
+mod_network::mod_network()
+    : _netlink(socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                      NETLINK_ROUTE))
+    , _interval(NETWORK_INTERVAL) {
+  sockaddr_nl addr{.nl_family = AF_NETLINK, .nl_groups = RTMGRP_LINK};
+  if (_netlink == -1 ||
+      bind(_netlink, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+    // without links there is nothing to show, but the bar still works
+    std::cerr << "Couldn't listen to link changes, not showing the network\n";
+    if (_netlink != -1) {
+      close(_netlink);
+      _netlink = -1;
+    }
+  }
+}
+
+mod_network::~mod_network() {
+  if (_netlink != -1) {
+    close(_netlink);
+  }
+}
+
+
+/** run
+ * Learn the current links and sample the counters. Link changes are watched
+ * by a second coroutine.
+ */
+cppcoro::task<>
+mod_network::run(EventLoop& loop) {
+  if (_netlink == -1) {
+    co_return;
+  }
+
+  // ask for every link; the replies are RTM_NEWLINK messages like any change
+  struct {
+    nlmsghdr header;
+    rtgenmsg message;
+  } request{.header = {.nlmsg_len = sizeof(request),
+                       .nlmsg_type = RTM_GETLINK,
+                       .nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP,
+                       .nlmsg_seq = 1},
+            .message = {.rtgen_family = AF_UNSPEC}};
+  send(_netlink, &request, sizeof(request), 0);
+  read_links();
+
+  bool active = false;
+  sample(active);
+  render();
+  notify();
+  loop.spawn(watch_links(loop));
+
+  while (true) {
+    co_await loop.sleep_for(_interval);
+    if (sample(active)) {
+      render();
+      notify();
+    }
+    // no traffic, no need to look as often
+    _interval = active ? NETWORK_INTERVAL
+                       : std::min<clock::duration>(_interval * 2,
+                                                   NETWORK_IDLE_INTERVAL);
+  }
+}
+
+cppcoro::task<>
+mod_network::watch_links(EventLoop& loop) {
+  while (true) {
+    co_await loop.readable(_netlink);
+    if (read_links()) {
+      // a new link is likely to see traffic soon
+      _interval = NETWORK_INTERVAL;
+      render();
+      notify();
+    }
+  }
+}
+
+
+/** read_links
+ * Apply the pending link messages. Returns whether any interface appeared,
+ * disappeared or changed state.
+ */
+bool
+mod_network::read_links() {
+  bool changed = false;
+  while (true) {
+    const ssize_t count =
+        recv(_netlink, _message.data(), _message.size(), MSG_DONTWAIT);
+    if (count <= 0) {
+      return changed;
+    }
+
+    auto length = static_cast<unsigned>(count);
+    for (auto* header = reinterpret_cast<nlmsghdr*>(_message.data());
+         NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+      if (header->nlmsg_type != RTM_NEWLINK &&
+          header->nlmsg_type != RTM_DELLINK) {
+        continue;
+      }
+      const auto* info = static_cast<const ifinfomsg*>(NLMSG_DATA(header));
+      auto itr = std::ranges::find(_interfaces, info->ifi_index,
+                                   &interface_t::index);
+
+      if (header->nlmsg_type == RTM_DELLINK ||
+          (info->ifi_flags & IFF_LOOPBACK) != 0) {
+        if (itr != _interfaces.end()) {
+          _interfaces.erase(itr);
+          changed = true;
+        }
+        continue;
+      }
+
+      if (itr == _interfaces.end()) {
+        itr = _interfaces.insert(_interfaces.end(),
+                                 {.index = info->ifi_index});
+      }
+      auto attr_length = static_cast<unsigned>(IFLA_PAYLOAD(header));
+      for (const auto* attr = IFLA_RTA(info); RTA_OK(attr, attr_length);
+           attr = RTA_NEXT(attr, attr_length)) {
+        if (attr->rta_type == IFLA_IFNAME) {
+          changed |= assign_if_changed(
+              itr->name, static_cast<const char*>(RTA_DATA(attr)));
+        }
+      }
+
+      const bool up = (info->ifi_flags & IFF_UP) != 0;
+      const bool carrier = (info->ifi_flags & IFF_RUNNING) != 0;
+      changed |= up != itr->up || carrier != itr->carrier;
+      itr->up = up;
+      itr->carrier = carrier;
+    }
+  }
+}
+
+/** sample
+ * Read the byte counters and update the rates. Returns whether any shown rate
+ * changed; `active` is set to whether there was any traffic.
+ */
+bool
+mod_network::sample(bool& active) {
+  const auto now = clock::now();
+  const double seconds =
+      std::chrono::duration<double>(now - _sampled_at).count();
+  _sampled_at = now;
+
+  bool changed = false;
+  active = false;
+  std::array<char, 16> buffer;
+
+  // "  eth0: rx_bytes rx_packets ... (8 rx fields) tx_bytes ..."
+  std::string_view dev = _dev.read();
+  for (size_t end = dev.find('\n'); end != std::string_view::npos;
+       dev.remove_prefix(end + 1), end = dev.find('\n')) {
+    std::string_view line = dev.substr(0, end);
+    const size_t colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      continue;  // one of the two header lines
+    }
+    std::string_view name = line.substr(0, colon);
+    name.remove_prefix(std::min(name.find_first_not_of(' '), name.size()));
+    auto itr = std::ranges::find(_interfaces, name, &interface_t::name);
+    if (itr == _interfaces.end()) {
+      continue;
+    }
+
+    line.remove_prefix(colon + 1);
+    const uint64_t rx = scan_uint(line);
+    for (int field = 1; field < 8; ++field) {
+      scan_uint(line);
+    }
+    const uint64_t tx = scan_uint(line);
+
+    if (itr->sampled && seconds > 0) {
+      const uint64_t rx_delta = rx - std::min(rx, itr->rx);
+      const uint64_t tx_delta = tx - std::min(tx, itr->tx);
+      active |= rx_delta > 0 || tx_delta > 0;
+      changed |= assign_if_changed(
+          itr->rx_rate,
+          format_rate(buffer, static_cast<double>(rx_delta) / seconds));
+      changed |= assign_if_changed(
+          itr->tx_rate,
+          format_rate(buffer, static_cast<double>(tx_delta) / seconds));
+    }
+    itr->sampled = true;
+    itr->rx = rx;
+    itr->tx = tx;
+  }
+  return changed;
+}
+
+/** render
+ * One segment per interface which is up.
+ */
+void
+mod_network::render() {
+  size_t count = 0;
+  for (const auto& interface : _interfaces) {
+    if (!interface.up) {
+      continue;
+    }
+    if (_segments.size() <= count) {
+      _segments.emplace_back();
+    }
+    // the texts are reused, so their strings keep their capacity
+    auto& texts = _segments[count++].segments;
+    texts.resize(interface.carrier ? 4 : 2);
+    texts[0].str.assign(interface.name);
+    texts[0].str.push_back(' ');
+    texts[0].color = NORMAL_COLOR;
+    texts[1].color = ACCENT_COLOR;
+    if (!interface.carrier) {
+      texts[1].str.assign("down");
+      continue;
+    }
+    const auto rate = [](const std::string& str) -> std::string_view {
+      return str.empty() ? "-" : str;
+    };
+    texts[1].str.assign(rate(interface.rx_rate));
+    texts[2].str.assign("/");
+    texts[2].color = NORMAL_COLOR;
+    texts[3].str.assign(rate(interface.tx_rate));
+    texts[3].color = ACCENT_COLOR;
+  }
+  _segments.resize(count);
+}
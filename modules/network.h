@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cppcoro/task.hpp>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../event_loop.h"
+#include "../types.h"
+#include "module.h"
+#include "system.h"
+
+
+/** mod_network
+ * Shows the receive and transmit rate of every interface which is up, or that
+ * it has no carrier. Links are learned from rtnetlink (RTM_NEWLINK and
+ * RTM_DELLINK), so a link change is shown as soon as it happens without
+ * polling. The byte counters are sampled from /proc/net/dev every
+ * NETWORK_INTERVAL, backing off up to NETWORK_IDLE_INTERVAL while there is no
+ * traffic. Where rtnetlink isn't available the module shows nothing.
+ *
+ * Rates are formatted into fixed buffers and only copied into the segments,
+ * and the bar only updated, when the shown text changes.
+ */
+class mod_network : public CoroutineModule<mod_network> {
+  friend class CoroutineModule<mod_network>;
+
+ public:
+  mod_network();
+  ~mod_network();
+
+  mod_network(const mod_network&) = delete;
+  mod_network(mod_network&&) = delete;
+  mod_network& operator=(const mod_network&) = delete;
+  mod_network& operator=(mod_network&&) = delete;
+
+  cppcoro::task<> run(EventLoop& loop);
+
+ private:
+  using clock = EventLoop::clock;
+
+  struct interface_t {
+    int index;
+    std::string name;
+    bool up{false};
+    bool carrier{false};
+    bool sampled{false};
+    uint64_t rx{0};
+    uint64_t tx{0};
+    std::string rx_rate;
+    std::string tx_rate;
+  };
+
+  cppcoro::task<> watch_links(EventLoop& loop);
+  bool read_links();
+  bool sample(bool& active);
+  void render();
+
+  int _netlink;
+  proc_file_t _dev{"/proc/net/dev"};
+  alignas(8) std::array<char, 16384> _message;
+  std::vector<interface_t> _interfaces;
+  clock::time_point _sampled_at;
+  clock::duration _interval;
+
+  std::vector<segment_t> _segments;
+};
@@ -0,0 +1,145 @@
+#include "ring.h"
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <utility>  // swap
+
+// how often a frame the producer is rewriting is read again before waiting
+// for the next doorbell
+static constexpr int max_attempts = 4;
+
+
+mod_ring::mod_ring(const char* name)
+    : _name(name)
+    , _memory_fd(memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING))
+    , _doorbell_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , _ring(nullptr) {
+  if (_memory_fd == -1 || _doorbell_fd == -1 ||
+      ftruncate(_memory_fd, sizeof(limebar_ring)) == -1) {
+    std::cerr << "Couldn't create the ring of " << name << '\n';
+    exit(EXIT_FAILURE);
+  }
+  // the producer must not be able to truncate the memory from under us
+  fcntl(_memory_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+  void* memory = mmap(nullptr, sizeof(limebar_ring), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, _memory_fd, 0);
+  if (memory == MAP_FAILED) {
+    std::cerr << "Couldn't map the ring of " << name << '\n';
+    exit(EXIT_FAILURE);
+  }
+  _ring = static_cast<limebar_ring*>(memory);
+  _ring->magic = LIMEBAR_RING_MAGIC;
+  _ring->version = LIMEBAR_RING_VERSION;
+  _ring->slots = LIMEBAR_RING_SLOTS;
+}
+
+mod_ring::~mod_ring() {
+  munmap(_ring, sizeof(limebar_ring));
+  close(_doorbell_fd);
+  close(_memory_fd);
+}
+
+
+/** run
+ * Ask for the doorbell, wait for it and read the newest frame.
+ */
+cppcoro::task<>
+mod_ring::run(EventLoop& loop) {
+  while (true) {
+    __atomic_store_n(&_ring->armed, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&_ring->head, __ATOMIC_SEQ_CST) != _seen) {
+      // published before we asked, so nobody rang
+      const uint64_t one = 1;
+      write(_doorbell_fd, &one, sizeof(one));
+    }
+
+    co_await loop.readable(_doorbell_fd);
+    uint64_t rings;
+    read(_doorbell_fd, &rings, sizeof(rings));
+
+    if (consume()) {
+      notify();
+    }
+  }
+}
+
+/** consume
+ * Copy the newest frame into scratch segments. The frame is validated
+ * afterwards and copied again if the producer has overwritten it in the
+ * meantime, so only a complete frame is swapped into the segments which are
+ * drawn. Returns whether there was a new frame.
+ *
+ * A producer which keeps lapping us is only raced max_attempts times. The
+ * previous frame then stays up and the new one unseen, so run() rings the
+ * doorbell itself and the next attempt is made once the rest of the loop had
+ * its turn.
+ */
+bool
+mod_ring::consume() {
+  for (int attempt = 0; attempt < max_attempts; ++attempt) {
+    const uint64_t head = __atomic_load_n(&_ring->head, __ATOMIC_ACQUIRE);
+    if (head == _seen) {
+      return false;
+    }
+
+    const limebar_frame& frame =
+        _ring->frames[(head - 1) % LIMEBAR_RING_SLOTS];
+    const uint64_t sequence =
+        __atomic_load_n(&frame.sequence, __ATOMIC_ACQUIRE);
+    if (sequence != 2 * head) {
+      // the producer has lapped us and is rewriting the slot
+      continue;
+    }
+
+    // the frame comes from another process, so don't trust its layout
+    const uint32_t run_count =
+        std::min<uint32_t>(frame.run_count, LIMEBAR_FRAME_RUNS);
+    size_t segment_count = 0;
+    size_t text_count = 0;
+    for (uint32_t i = 0; i < run_count; ++i) {
+      const limebar_run& run = frame.runs[i];
+      if (run.offset + run.length > LIMEBAR_FRAME_TEXT) {
+        continue;
+      }
+      if (run.starts_segment != 0 || segment_count == 0) {
+        if (segment_count > 0) {
+          _scratch[segment_count - 1].segments.resize(text_count);
+        }
+        if (_scratch.size() <= segment_count) {
+          _scratch.emplace_back();
+        }
+        ++segment_count;
+        text_count = 0;
+      }
+
+      auto& texts = _scratch[segment_count - 1].segments;
+      if (texts.size() <= text_count) {
+        texts.emplace_back();
+      }
+      texts[text_count].str.assign(frame.text + run.offset, run.length);
+      texts[text_count].color =
+          run.color == LIMEBAR_ACCENT ? ACCENT_COLOR : NORMAL_COLOR;
+      ++text_count;
+    }
+    if (segment_count > 0) {
+      _scratch[segment_count - 1].segments.resize(text_count);
+    }
+    _scratch.resize(segment_count);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&frame.sequence, __ATOMIC_RELAXED) == sequence) {
+      // the previous frame's strings are reused by the next copy
+      std::swap(_segments, _scratch);
+      _seen = head;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cppcoro/task.hpp>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "../event_loop.h"
+#include "../limebar_ring.h"
+#include "../types.h"
+#include "module.h"
+
+
+/** mod_ring
+ * A module fed by a high frequency producer through a shared memory ring (see
+ * limebar_ring.h). The ring and its doorbell are handed to the producer by the
+ * control socket, where the module is addressed by `name`.
+ *
+ * Only the newest frame is read when the doorbell rings, frames published in
+ * between are skipped. Its text is copied straight from shared memory into the
+ * strings of a second set of segments, which is swapped with the drawn one once
+ * the copy is known to be whole. A producer whose layout doesn't change causes
+ * no allocations. The ring has a single producer; handing it to more than one
+ * is not supported.
+ */
+class mod_ring : public CoroutineModule<mod_ring> {
+  friend class CoroutineModule<mod_ring>;
+
+ public:
+  explicit mod_ring(const char* name);
+  ~mod_ring();
+
+  mod_ring(const mod_ring&) = delete;
+  mod_ring(mod_ring&&) = delete;
+  mod_ring& operator=(const mod_ring&) = delete;
+  mod_ring& operator=(mod_ring&&) = delete;
+
+  cppcoro::task<> run(EventLoop& loop);
+
+  [[nodiscard]] std::string_view name() const { return _name; }
+  // memfd holding the ring and eventfd of the doorbell, for the producer
+  [[nodiscard]] int memory_fd() const { return _memory_fd; }
+  [[nodiscard]] int doorbell_fd() const { return _doorbell_fd; }
+
+ private:
+  bool consume();
+
+  const char* _name;
+  int _memory_fd;
+  int _doorbell_fd;
+  limebar_ring* _ring;
+  uint64_t _seen{0};  // head of the ring when it was last read
+
+  std::vector<segment_t> _segments;
+  std::vector<segment_t> _scratch;  // what consume() copies a frame into
+};
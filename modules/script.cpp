@@ -0,0 +1,179 @@
+#include "script.h"
+
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cppcoro/single_consumer_event.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <utility>  // exchange, swap
+
+#include "../config.h"
+#include "../subprocess.h"
+
+
+/** script_slots
+ * Limits how many commands run at once. A slot which is released while others
+ * are waiting is handed to the longest waiting one.
+ */
+static struct {
+  size_t free = SCRIPT_CONCURRENCY;
+  std::deque<cppcoro::single_consumer_event*> waiting;
+} script_slots;
+
+static cppcoro::task<>
+acquire_slot() {
+  if (script_slots.free > 0) {
+    --script_slots.free;
+    co_return;
+  }
+  cppcoro::single_consumer_event event;
+  script_slots.waiting.push_back(&event);
+  co_await event;
+}
+
+static void
+release_slot() {
+  if (script_slots.waiting.empty()) {
+    ++script_slots.free;
+    return;
+  }
+  auto* next = script_slots.waiting.front();
+  script_slots.waiting.pop_front();
+  next->set();
+}
+
+
+mod_script::mod_script(const char* command, std::chrono::milliseconds interval)
+    : _command(command)
+    , _interval(interval)
+    , _kick(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  if (_kick == -1) {
+    std::cerr << "Couldn't create an eventfd for " << command << '\n';
+    exit(EXIT_FAILURE);
+  }
+  _segments[0].action = [this](uint8_t button) {
+    _button = button;
+    kick();
+  };
+}
+
+mod_script::~mod_script() {
+  close(_kick);
+}
+
+
+/** run
+ * Run the command whenever the interval passes or the module is clicked.
+ * Requests which come in while the command is running are folded into one
+ * more run.
+ */
+cppcoro::task<>
+mod_script::run(EventLoop& loop) {
+  if (_interval > std::chrono::milliseconds::zero()) {
+    loop.timers().add(EventLoop::clock::now(), _interval, [this] { kick(); });
+  } else {
+    kick();
+  }
+
+  while (true) {
+    co_await loop.readable(_kick);
+    uint64_t requests;
+    read(_kick, &requests, sizeof(requests));
+
+    if (co_await execute(loop) && _output != _shown) {
+      std::swap(_output, _shown);
+      refresh();
+      notify();
+    }
+  }
+}
+
+/** execute
+ * Run the command once, collecting its stdout into _output. Returns false if
+ * it couldn't be run or was killed.
+ */
+cppcoro::task<bool>
+mod_script::execute(EventLoop& loop) {
+  co_await acquire_slot();
+  struct slot_guard_t {
+    ~slot_guard_t() { release_slot(); }
+  } slot_guard;
+
+  std::array<char, 16> button;
+  snprintf(button.data(), button.size(), "BLOCK_BUTTON=%u",
+           static_cast<unsigned>(std::exchange(_button, 0)));
+  const auto child = spawn_shell(_command, button.data());
+  if (!child) {
+    std::cerr << "Couldn't run " << _command << '\n';
+    co_return false;
+  }
+
+  const auto timeout = loop.timers().add(
+      EventLoop::clock::now() + SCRIPT_TIMEOUT,
+      [child = *child] { kill_child(child); });
+
+  // the pipe reaches EOF once the command and anything it started are gone
+  _output.clear();
+  bool open = true;
+  while (open) {
+    co_await loop.readable(child->output);
+    while (true) {
+      const ssize_t count = read(child->output, _chunk.data(), _chunk.size());
+      if (count > 0) {
+        _output.append(_chunk.data(), static_cast<size_t>(count));
+      } else if (count == -1 && errno == EINTR) {
+        continue;
+      } else {
+        open = count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        break;
+      }
+    }
+  }
+  loop.forget(child->output);
+
+  if (child->pidfd != -1) {
+    co_await loop.readable(child->pidfd);
+    loop.forget(child->pidfd);
+  }
+  // Without a pidfd there is nothing to wait on, as the command may live on
+  // after closing its stdout. Check back until it exits or the timeout kills
+  // it.
+  std::optional<int> status;
+  while (!(status = try_reap_child(*child))) {
+    co_await loop.sleep_for(SCRIPT_REAP_INTERVAL);
+  }
+  loop.timers().cancel(timeout);
+  co_return !WIFSIGNALED(*status);
+}
+
+void
+mod_script::kick() const {
+  const uint64_t one = 1;
+  write(_kick, &one, sizeof(one));
+}
+
+
+/** refresh
+ * Show the first line of the output. An empty line leaves the segment without
+ * any text, which still keeps it clickable.
+ */
+void
+mod_script::refresh() {
+  std::string_view line(_shown);
+  line = line.substr(0, line.find('\n'));
+  auto& texts = _segments[0].segments;
+  if (line.empty()) {
+    texts.clear();
+  } else if (texts.empty()) {
+    texts.push_back({.str = std::string(line), .color = NORMAL_COLOR});
+  } else {
+    texts[0].str.assign(line);
+  }
+}
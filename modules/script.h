@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cppcoro/task.hpp>
+#include <cstdint>
+#include <string>
+
+#include "../event_loop.h"
+#include "../types.h"
+#include "module.h"
+
+
+/** mod_script
+ * Shows the first line of what a shell command prints, i3blocks style. The
+ * command is run every `interval`, or only when clicked if the interval is
+ * zero, and on every click with the button in $BLOCK_BUTTON.
+ *
+ * Commands are spawned without stalling the bar and their output is read on
+ * the EventLoop. At most SCRIPT_CONCURRENCY commands run at once across all
+ * script modules, and a command still running after SCRIPT_TIMEOUT is killed.
+ * The bar is only updated when the output differs from the last run.
+ */
+class mod_script : public CoroutineModule<mod_script> {
+  friend class CoroutineModule<mod_script>;
+
+ public:
+  explicit mod_script(const char* command,
+                      std::chrono::milliseconds interval =
+                          std::chrono::milliseconds::zero());
+  ~mod_script();
+
+  mod_script(const mod_script&) = delete;
+  mod_script(mod_script&&) = delete;
+  mod_script& operator=(const mod_script&) = delete;
+  mod_script& operator=(mod_script&&) = delete;
+
+  cppcoro::task<> run(EventLoop& loop);
+
+ private:
+  cppcoro::task<bool> execute(EventLoop& loop);
+  void kick() const;
+  void refresh();
+
+  const char* _command;
+  std::chrono::milliseconds _interval;
+  int _kick;  // eventfd asking for the command to be run
+  uint8_t _button{0};
+
+  std::string _output;  // of the current run
+  std::string _shown;   // the output of the last run
+  std::array<char, 4096> _chunk;
+
+  std::array<segment_t, 1> _segments;
+};
@@ -0,0 +1,176 @@
+#include "system.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+
+/** scan_uint
+ * Parse the unsigned integer which follows any blanks at the start of `str`
+ * and advance `str` past it.
+ */
+uint64_t
+scan_uint(std::string_view& str) {
+  size_t i = 0;
+  while (i < str.size() && (str[i] == ' ' || str[i] == '\t')) {
+    ++i;
+  }
+  uint64_t value = 0;
+  for (; i < str.size() && str[i] >= '0' && str[i] <= '9'; ++i) {
+    value = value * 10 + static_cast<uint64_t>(str[i] - '0');
+  }
+  str.remove_prefix(i);
+  return value;
+}
+
+/** scan_field
+ * The value of the line starting with `key` in a file of "key value" lines.
+ */
+static uint64_t
+scan_field(std::string_view file, std::string_view key) {
+  for (size_t pos = file.find(key); pos != std::string_view::npos;
+       pos = file.find(key, pos + 1)) {
+    if (pos == 0 || file[pos - 1] == '\n') {
+      std::string_view value = file.substr(pos + key.size());
+      return scan_uint(value);
+    }
+  }
+  return 0;
+}
+
+/** make_segment
+ * A label followed by its value in the accent color, like the clock.
+ */
+static segment_t
+make_segment(const char* label) {
+  return {.segments{{.str{label}, .color = NORMAL_COLOR},
+                    {.str{}, .color = ACCENT_COLOR}}};
+}
+
+/** set_value
+ * Replace the value of a segment made by make_segment(). Nothing is written if
+ * it is unchanged, so the fingerprint of the module stays the same and the
+ * redraw is skipped.
+ */
+static void
+set_value(segment_t& seg, std::string_view value) {
+  auto& str = seg.segments[1].str;
+  if (str != value) {
+    str.assign(value);
+  }
+}
+
+/** format_percent
+ * `percent`, clamped to 100, followed by '%'.
+ */
+static std::string_view
+format_percent(std::array<char, 8>& buffer, uint64_t percent) {
+  const int length =
+      snprintf(buffer.data(), buffer.size(), "%u%%",
+               static_cast<unsigned>(std::min<uint64_t>(percent, 100)));
+  return {buffer.data(), length < 0 ? 0
+                                    : std::min(static_cast<size_t>(length),
+                                               buffer.size() - 1)};
+}
+
+
+proc_file_t::proc_file_t(const char* path)
+    : _fd(open(path, O_RDONLY | O_CLOEXEC)), _buffer(4096) {
+  if (_fd == -1) {
+    std::cerr << "Couldn't open " << path << '\n';
+    exit(EXIT_FAILURE);
+  }
+}
+
+proc_file_t::proc_file_t(int fd) : _fd(fd), _buffer(4096) {
+}
+
+proc_file_t::~proc_file_t() {
+  close(_fd);
+}
+
+std::string_view
+proc_file_t::read() {
+  while (true) {
+    const ssize_t count = pread(_fd, _buffer.data(), _buffer.size(), 0);
+    if (count <= 0) {
+      return {};
+    }
+    // a full buffer may have cut the file short, read it again with room
+    if (static_cast<size_t>(count) < _buffer.size()) {
+      return {_buffer.data(), static_cast<size_t>(count)};
+    }
+    _buffer.resize(_buffer.size() * 2);
+  }
+}
+
+
+mod_cpu::mod_cpu(std::chrono::milliseconds interval)
+    : PeriodicModule(interval), _segments({make_segment("cpu ")}) {
+}
+
+void
+mod_cpu::refresh() {
+  // cpu  user nice system idle iowait irq softirq steal ...
+  std::string_view line = _stat.read();
+  if (!line.starts_with("cpu ")) {
+    return;
+  }
+  line.remove_prefix(4);
+
+  std::array<uint64_t, 8> ticks;
+  for (auto& value : ticks) {
+    value = scan_uint(line);
+  }
+  uint64_t total = 0;
+  for (uint64_t value : ticks) {
+    total += value;
+  }
+  const uint64_t busy = total - ticks[3] - ticks[4];
+
+  // the counters can go backwards, e.g. when a CPU goes offline
+  const uint64_t elapsed = total > _total ? total - _total : 0;
+  const uint64_t worked = busy > _busy ? busy - _busy : 0;
+  const uint64_t percent = elapsed == 0 ? 0 : worked * 100 / elapsed;
+  _busy = busy;
+  _total = total;
+
+  std::array<char, 8> value;
+  set_value(_segments[0], format_percent(value, percent));
+}
+
+
+mod_load::mod_load(std::chrono::milliseconds interval)
+    : PeriodicModule(interval), _segments({make_segment("load ")}) {
+}
+
+void
+mod_load::refresh() {
+  // the load averages are already formatted, show the first one as it is
+  const std::string_view loadavg = _loadavg.read();
+  set_value(_segments[0], loadavg.substr(0, loadavg.find(' ')));
+}
+
+
+mod_memory::mod_memory(std::chrono::milliseconds interval)
+    : PeriodicModule(interval), _segments({make_segment("mem ")}) {
+}
+
+void
+mod_memory::refresh() {
+  const std::string_view meminfo = _meminfo.read();
+  const uint64_t total = scan_field(meminfo, "MemTotal:");
+  const uint64_t available = scan_field(meminfo, "MemAvailable:");
+  if (total == 0 || available > total) {
+    return;
+  }
+
+  std::array<char, 8> value;
+  set_value(_segments[0],
+            format_percent(value, (total - available) * 100 / total));
+}
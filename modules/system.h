@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "../types.h"
+#include "module.h"
+
+
+/** proc_file_t
+ * A file in /proc or /sys which is kept open and re-read from the start into a
+ * buffer, so that sampling it costs one pread and no allocations. The buffer
+ * grows whenever the file doesn't fit, e.g. /proc/net/dev on a host with many
+ * interfaces, and is kept at that size.
+ */
+class proc_file_t {
+ public:
+  explicit proc_file_t(const char* path);
+  // Take over `fd`, which is already open.
+  explicit proc_file_t(int fd);
+  ~proc_file_t();
+
+  proc_file_t(const proc_file_t&) = delete;
+  proc_file_t(proc_file_t&&) = delete;
+  proc_file_t& operator=(const proc_file_t&) = delete;
+  proc_file_t& operator=(proc_file_t&&) = delete;
+
+  // The whole file, valid until the next read().
+  std::string_view read();
+
+ private:
+  int _fd;
+  std::vector<char> _buffer;
+};
+
+
+uint64_t scan_uint(std::string_view& str);
+
+
+/** mod_cpu
+ * Shows how busy all CPUs were since the previous refresh.
+ */
+class mod_cpu : public PeriodicModule<mod_cpu> {
+  friend class DynamicModule<mod_cpu>;
+
+ public:
+  explicit mod_cpu(std::chrono::milliseconds interval);
+  void refresh();
+
+ private:
+  proc_file_t _stat{"/proc/stat"};
+  uint64_t _busy{0};
+  uint64_t _total{0};
+
+  std::array<segment_t, 1> _segments;
+};
+
+
+/** mod_load
+ * Shows the load average of the last minute.
+ */
+class mod_load : public PeriodicModule<mod_load> {
+  friend class DynamicModule<mod_load>;
+
+ public:
+  explicit mod_load(std::chrono::milliseconds interval);
+  void refresh();
+
+ private:
+  proc_file_t _loadavg{"/proc/loadavg"};
+
+  std::array<segment_t, 1> _segments;
+};
+
+
+/** mod_memory
+ * Shows how much of the memory is in use, i.e. not available to be allocated
+ * without swapping.
+ */
+class mod_memory : public PeriodicModule<mod_memory> {
+  friend class DynamicModule<mod_memory>;
+
+ public:
+  explicit mod_memory(std::chrono::milliseconds interval);
+  void refresh();
+
+ private:
+  proc_file_t _meminfo{"/proc/meminfo"};
+
+  std::array<segment_t, 1> _segments;
+};
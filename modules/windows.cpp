@@ -1,22 +1,31 @@
 #include "windows.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <utility>
 
 #include "../x.h"
 
 
 mod_windows::mod_windows()
     : _conn(get_connection())
-    , _current_desktop_atom(get_atom(_conn, "_NET_CURRENT_DESKTOP"))
-    , _active_window_atom(get_atom(_conn, "_NET_ACTIVE_WINDOW"))
+    , _current_desktop_atom(DS::Instance().atom(atom_e::NET_CURRENT_DESKTOP))
+    , _active_window_atom(DS::Instance().atom(atom_e::NET_ACTIVE_WINDOW))
+    , _client_list_atom(DS::Instance().atom(atom_e::NET_CLIENT_LIST))
+    , _wm_state_atom(DS::Instance().atom(atom_e::NET_WM_STATE))
     , _ds(DS::Instance()) {
   if (xcb_connection_has_error(_conn)) {
     std::cerr << "Cannot X connection for workspaces daemon.\n";
     exit(EXIT_FAILURE);
   }
+  if (xcb_ewmh_init_atoms_replies(
+          &_ewmh, xcb_ewmh_init_atoms(_conn, &_ewmh), nullptr) == 0) {
+    std::cerr << "Couldn't initialize EWMH atoms for the windows module\n";
+    exit(EXIT_FAILURE);
+  }
 
   uint32_t values = XCB_EVENT_MASK_PROPERTY_CHANGE;
   xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(_conn)).data;
@@ -25,6 +34,7 @@ mod_windows::mod_windows()
 }
 
 mod_windows::~mod_windows() {
+  xcb_ewmh_connection_wipe(&_ewmh);
   xcb_disconnect(_conn);
 }
 
@@ -38,41 +48,131 @@ mod_windows::has_work() {
     }
     // TODO: can we filter in the display server to only return these values
     // in the first place so we don't have to check every time?
-    if ((ev->response_type & 0x7F) == XCB_PROPERTY_NOTIFY) {
-      auto atom =
-          reinterpret_cast<xcb_property_notify_event_t *>(ev.get())->atom;
-      if (atom == _active_window_atom || atom == _current_desktop_atom) {
-        return true;
+    if ((ev->response_type & 0x7F) != XCB_PROPERTY_NOTIFY) {
+      continue;
+    }
+    const auto *property =
+        reinterpret_cast<xcb_property_notify_event_t *>(ev.get());
+    const auto atom = property->atom;
+    if (atom == _active_window_atom || atom == _current_desktop_atom ||
+        atom == _client_list_atom) {
+      std::lock_guard lock(_pending_mutex);
+      _pending_refresh = true;
+      return true;
+    }
+    // sent for the clients, see refresh()
+    if (atom == XCB_ATOM_WM_HINTS || atom == _wm_state_atom) {
+      std::lock_guard lock(_pending_mutex);
+      if (std::ranges::find(_pending_urgency, property->window) ==
+          _pending_urgency.end()) {
+        _pending_urgency.push_back(property->window);
       }
+      return true;
     }
   }
 }
 
 void
 mod_windows::do_work() {
-  uint32_t current_workspace = _ds.get_current_workspace();
-  xcb_window_t current_window = _ds.get_active_window();
+  bool refresh_all = false;
+  std::vector<xcb_window_t> urgency;
+  {
+    std::lock_guard lock(_pending_mutex);
+    refresh_all = std::exchange(_pending_refresh, false);
+    urgency.swap(_pending_urgency);
+  }
 
-  _segments.clear();
-  for (xcb_window_t window : _ds.get_windows()) {
-    std::string title = _ds.get_window_title(window);
+  // a refresh reads the urgency of new clients itself and knows the rest
+  if (!urgency.empty()) {
+    update_urgency(urgency);
+  }
+  if (refresh_all) {
+    refresh();
+  }
+  render();
+}
+
+/** refresh
+ * Fetch the client list and the windows on the current desktop. Clients which
+ * weren't listed before are selected for PropertyChange before their urgency
+ * is read, so no change of it can be missed.
+ *
+ * The queries are made on the module's own connection. Waiting for their
+ * replies on the DS connection would have xcb queue the bars' events while the
+ * main thread's epoll sees its socket drained, holding clicks up until the job
+ * is done.
+ */
+void
+mod_windows::refresh() {
+  uint32_t current_workspace = get_current_workspace(&_ewmh);
+  _active = get_active_window(&_ewmh);
+
+  std::unordered_map<xcb_window_t, bool> clients;
+  _shown.clear();
+  for (xcb_window_t window : get_windows(&_ewmh)) {
+    auto known = _clients.find(window);
+    if (known == _clients.end()) {
+      const uint32_t values = XCB_EVENT_MASK_PROPERTY_CHANGE;
+      xcb_change_window_attributes(_conn, window, XCB_CW_EVENT_MASK, &values);
+      xcb_flush(_conn);
+      known =
+          _clients.emplace(window, is_window_urgent(&_ewmh, window)).first;
+    }
+    clients.insert(*known);
+
+    std::string title = get_window_title(&_ewmh, window);
     if (title.empty()) {
       continue;
     }
 
-    auto workspace = _ds.get_workspace_of_window(window);
+    auto workspace = get_workspace_of_window(&_ewmh, window);
     if (!workspace.has_value() || workspace != current_workspace) {
       continue;
     }
 
+    _shown.push_back(
+        {.window = window, .title = std::move(title), .urgent = known->second});
+  }
+  // closed clients are dropped
+  _clients = std::move(clients);
+}
+
+/** update_urgency
+ * Read the urgency of `windows` again, which had their hints changed.
+ */
+void
+mod_windows::update_urgency(const std::vector<xcb_window_t>& windows) {
+  for (xcb_window_t window : windows) {
+    auto client = _clients.find(window);
+    if (client == _clients.end()) {
+      continue;
+    }
+    client->second = is_window_urgent(&_ewmh, window);
+    auto shown = std::ranges::find(_shown, window, &window_t::window);
+    if (shown != _shown.end()) {
+      shown->urgent = client->second;
+    }
+  }
+}
+
+/** render
+ * One segment per shown window. The segments are built again from _shown as
+ * the last published ones were handed to the AsyncModule.
+ */
+void
+mod_windows::render() {
+  _segments.clear();
+  for (const auto& [window, title, urgent] : _shown) {
     _segments.push_back(
         {.segments{{.str{title},
-                    .color = (window == current_window ? ACCENT_COLOR
-                                                       : NORMAL_COLOR)}},
+                    .color = urgent              ? URGENT_COLOR
+                             : window == _active ? ACCENT_COLOR
+                                                 : NORMAL_COLOR}},
          .action = [this, window](uint8_t button) {
            if (button == 1) {
              _ds.activate_window(window);
            }
-         }});
+         },
+         .id = window});
   }
 }
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <xcb/xcb.h>
+#include <xcb/xcb_ewmh.h>
 
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "../config.h"
 #include "../types.h"
@@ -10,8 +14,20 @@
 
 // TODO: make special window container
 
-class mod_windows : public DynamicModule<mod_windows> {
-  friend class DynamicModule<mod_windows>;
+/** mod_windows
+ * Lists the windows on the current desktop. do_work() makes several round
+ * trips per window so it is run asynchronously, on the module's own connection
+ * so that the DS connection is left to the main thread. has_work() reads only
+ * events and is safe to call while do_work() is running.
+ *
+ * Windows which ask for attention (the WM_HINTS urgency bit or
+ * _NET_WM_STATE_DEMANDS_ATTENTION) are drawn in URGENT_COLOR. PropertyChange
+ * is selected on every client once, when it first appears in
+ * _NET_CLIENT_LIST, so a change of its hints arrives as an event and only that
+ * window's urgency is read again, without fetching the client list.
+ */
+class mod_windows : public AsyncModule<mod_windows, std::vector<segment_t>> {
+  friend class AsyncModule<mod_windows, std::vector<segment_t>>;
 
  public:
   mod_windows();
@@ -20,11 +36,37 @@ class mod_windows : public DynamicModule<mod_windows> {
   bool has_work();
   void do_work();
 
+  // the connection, for EventLoop::wake_on()
+  [[nodiscard]] int fd() const { return xcb_get_file_descriptor(_conn); }
+
  private:
+  struct window_t {
+    xcb_window_t window;
+    std::string title;
+    bool urgent;
+  };
+
+  void refresh();
+  void update_urgency(const std::vector<xcb_window_t>& windows);
+  void render();
+
   xcb_connection_t* _conn;
+  xcb_ewmh_connection_t _ewmh;  // on _conn, for the queries of do_work()
   const xcb_atom_t _current_desktop_atom;
   const xcb_atom_t _active_window_atom;
+  const xcb_atom_t _client_list_atom;
+  const xcb_atom_t _wm_state_atom;
   DS& _ds;
 
+  // what has_work() saw, taken by the next do_work()
+  std::mutex _pending_mutex;
+  bool _pending_refresh{true};
+  std::vector<xcb_window_t> _pending_urgency;
+
+  // only used by do_work()
+  std::unordered_map<xcb_window_t, bool> _clients;  // whether each is urgent
+  std::vector<window_t> _shown;
+  xcb_window_t _active{XCB_NONE};
+
   std::vector<segment_t> _segments;
 };
@@ -10,7 +10,7 @@
 
 mod_workspaces::mod_workspaces()
     : _conn(get_connection())
-    , _current_desktop(get_atom(_conn, "_NET_CURRENT_DESKTOP"))
+    , _current_desktop(DS::Instance().atom(atom_e::NET_CURRENT_DESKTOP))
     , _ds(DS::Instance()) {
   uint32_t values = XCB_EVENT_MASK_PROPERTY_CHANGE;
   xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(_conn)).data;
@@ -50,6 +50,7 @@ mod_workspaces::do_work() {
            if (button == 1) {
              _ds.switch_desktop(desk);
            }
-         }});
+         },
+         .id = static_cast<uint64_t>(i)});
   }
 }
@@ -15,6 +15,9 @@ class mod_workspaces : public DynamicModule<mod_workspaces> {
   bool has_work();
   void do_work();
 
+  // the connection, for EventLoop::wake_on()
+  [[nodiscard]] int fd() const { return xcb_get_file_descriptor(_conn); }
+
  private:
   xcb_connection_t* _conn;
   const xcb_atom_t _current_desktop;
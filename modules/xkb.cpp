@@ -0,0 +1,166 @@
+#include "xkb.h"
+
+// xcb/xkb.h names a struct member `explicit`
+#define explicit explicit_
+#include <xcb/xkb.h>
+#undef explicit
+
+#include <bit>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#include "../x.h"
+
+
+mod_xkb::mod_xkb() : _conn(get_connection()) {
+  std::unique_ptr<xcb_xkb_use_extension_reply_t, decltype(std::free)*> ext{
+      xcb_xkb_use_extension_reply(
+          _conn,
+          xcb_xkb_use_extension(_conn, XCB_XKB_MAJOR_VERSION,
+                                XCB_XKB_MINOR_VERSION),
+          nullptr),
+      std::free};
+  const auto* data = xcb_get_extension_data(_conn, &xcb_xkb_id);
+  if (!ext || !ext->supported || !data || !data->present) {
+    // the bar works without it, there is just no layout to show
+    std::cerr << "The X server doesn't support XKB, not showing the layout\n";
+    return;
+  }
+  _supported = true;
+  _first_event = data->first_event;
+
+  // only changes of the locked group, of the group names and of the keyboard
+  // itself are reported
+  const uint16_t events = XCB_XKB_EVENT_TYPE_NEW_KEYBOARD_NOTIFY |
+                          XCB_XKB_EVENT_TYPE_STATE_NOTIFY |
+                          XCB_XKB_EVENT_TYPE_NAMES_NOTIFY;
+  const uint16_t keyboard = XCB_XKB_NKN_DETAIL_KEYCODES |
+                            XCB_XKB_NKN_DETAIL_GEOMETRY |
+                            XCB_XKB_NKN_DETAIL_DEVICE_ID;
+  const xcb_xkb_select_events_details_t details{
+      .affectNewKeyboard = keyboard,
+      .newKeyboardDetails = keyboard,
+      .affectState = XCB_XKB_STATE_PART_GROUP_LOCK,
+      .stateDetails = XCB_XKB_STATE_PART_GROUP_LOCK,
+      .affectNames = XCB_XKB_NAME_DETAIL_GROUP_NAMES,
+      .namesDetails = XCB_XKB_NAME_DETAIL_GROUP_NAMES};
+  xcb_xkb_select_events_aux(_conn, XCB_XKB_ID_USE_CORE_KBD, events, 0, 0, 0, 0,
+                            &details);
+  xcb_flush(_conn);
+}
+
+mod_xkb::~mod_xkb() {
+  xcb_disconnect(_conn);
+}
+
+bool
+mod_xkb::has_work() {
+  bool changed = false;
+  while (true) {
+    std::unique_ptr<xcb_generic_event_t, decltype(std::free)*> ev{
+        xcb_poll_for_event(_conn), std::free};
+    if (!ev) {
+      return changed;
+    }
+    if (!_supported || (ev->response_type & 0x7F) != _first_event) {
+      continue;
+    }
+
+    // every XKB event shares the base event code, xkbType tells them apart
+    const auto* state =
+        reinterpret_cast<const xcb_xkb_state_notify_event_t*>(ev.get());
+    if (state->xkbType == XCB_XKB_NEW_KEYBOARD_NOTIFY ||
+        state->xkbType == XCB_XKB_NAMES_NOTIFY) {
+      _stale = true;
+      changed = true;
+    } else if (state->xkbType == XCB_XKB_STATE_NOTIFY &&
+               state->lockedGroup != _group) {
+      _group = state->lockedGroup;
+      changed = true;
+    }
+  }
+}
+
+void
+mod_xkb::do_work() {
+  if (!_supported) {
+    return;
+  }
+  if (_stale) {
+    fetch_names();
+  }
+
+  const std::string name = _group < _names.size()
+                               ? _names[_group]
+                               : std::to_string(_group + 1);
+  _segments = {{.segments{{.str = name, .color = ACCENT_COLOR}},
+                .action = [this](uint8_t button) {
+                  if (button == 1) {
+                    lock_group(1);
+                  } else if (button == 3) {
+                    lock_group(-1);
+                  }
+                }}};
+}
+
+/** fetch_names
+ * Fetch the locked group and the names of all groups. The GetAtomName requests
+ * are all sent before the first reply is read, so this costs two round trips
+ * however many layouts there are.
+ */
+void
+mod_xkb::fetch_names() {
+  const auto state_cookie = xcb_xkb_get_state(_conn, XCB_XKB_ID_USE_CORE_KBD);
+  const auto names_cookie = xcb_xkb_get_names(_conn, XCB_XKB_ID_USE_CORE_KBD,
+                                              XCB_XKB_NAME_DETAIL_GROUP_NAMES);
+
+  std::unique_ptr<xcb_xkb_get_state_reply_t, decltype(std::free)*> state{
+      xcb_xkb_get_state_reply(_conn, state_cookie, nullptr), std::free};
+  if (state) {
+    _group = state->lockedGroup;
+  }
+
+  std::unique_ptr<xcb_xkb_get_names_reply_t, decltype(std::free)*> names{
+      xcb_xkb_get_names_reply(_conn, names_cookie, nullptr), std::free};
+  _names.clear();
+  _stale = false;
+  if (!names) {
+    return;
+  }
+
+  xcb_xkb_get_names_value_list_t list;
+  xcb_xkb_get_names_value_list_unpack(
+      xcb_xkb_get_names_value_list(names.get()), names->nTypes,
+      names->indicators, names->virtualMods, names->groupNames, names->nKeys,
+      names->nKeyAliases, names->nRadioGroups, names->which, &list);
+
+  std::vector<xcb_get_atom_name_cookie_t> cookies;
+  for (int i = 0; i < std::popcount(names->groupNames); ++i) {
+    cookies.push_back(xcb_get_atom_name(_conn, list.groups[i]));
+  }
+  for (const auto& cookie : cookies) {
+    std::unique_ptr<xcb_get_atom_name_reply_t, decltype(std::free)*> reply{
+        xcb_get_atom_name_reply(_conn, cookie, nullptr), std::free};
+    _names.emplace_back(
+        reply ? std::string(xcb_get_atom_name_name(reply.get()),
+                            xcb_get_atom_name_name_length(reply.get()))
+              : std::string());
+  }
+}
+
+/** lock_group
+ * Lock the group `offset` away from the current one. The resulting
+ * StateNotify updates the bar.
+ */
+void
+mod_xkb::lock_group(int offset) {
+  const int count = static_cast<int>(_names.size());
+  if (count < 2) {
+    return;
+  }
+  const int group = ((_group + offset) % count + count) % count;
+  xcb_xkb_latch_lock_state(_conn, XCB_XKB_ID_USE_CORE_KBD, 0, 0, 1,
+                           static_cast<uint8_t>(group), 0, 0, 0);
+  xcb_flush(_conn);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <xcb/xcb.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../types.h"
+#include "module.h"
+
+
+/** mod_xkb
+ * Shows the current keyboard layout (XKB group). Clicking it locks the next
+ * layout, or the previous one with the right button.
+ *
+ * The module subscribes to the XKB StateNotify events, restricted to changes
+ * of the locked group, so has_work() sees nothing but layout switches. The
+ * names of the groups are fetched once, with all of the atom names requested
+ * before any reply is waited on, and only fetched again after a
+ * NewKeyboardNotify or NamesNotify. A layout switch only swaps the shown name.
+ * Without XKB on the server the module shows nothing.
+ */
+class mod_xkb : public DynamicModule<mod_xkb> {
+  friend class DynamicModule<mod_xkb>;
+
+ public:
+  mod_xkb();
+  ~mod_xkb();
+
+  mod_xkb(const mod_xkb&) = delete;
+  mod_xkb(mod_xkb&&) = delete;
+  mod_xkb& operator=(const mod_xkb&) = delete;
+  mod_xkb& operator=(mod_xkb&&) = delete;
+
+  bool has_work();
+  void do_work();
+
+  // the connection, for EventLoop::wake_on()
+  [[nodiscard]] int fd() const { return xcb_get_file_descriptor(_conn); }
+
+ private:
+  void fetch_names();
+  void lock_group(int offset);
+
+  xcb_connection_t* _conn;
+  bool _supported{false};  // whether the server has XKB
+  uint8_t _first_event{0};
+  uint8_t _group{0};
+  bool _stale{true};  // whether the keyboard changed since fetch_names()
+  std::vector<std::string> _names;
+
+  std::vector<segment_t> _segments;
+};
@@ -6,6 +6,13 @@
 
 #include "pixmap.h"
 
+#include <algorithm>
+
+#include "profiler.h"
+
+// width a section pixmap starts out with before it has seen any content
+static constexpr uint16_t initial_pixmap_width = 64;
+
 
 static ucs2
 utf8_to_ucs2(const std::string& text) {
@@ -55,16 +62,44 @@ utf8_to_ucs2(const std::string& text) {
   return str;
 }
 
+/** font_color
+ * The bar's font color for a segment's `color`.
+ */
+static FontColor*
+font_color(const BarColors& colors, font_color_e color) {
+  switch (color) {
+    case ACCENT_COLOR:
+      return colors.fg_accent.get();
+    case URGENT_COLOR:
+      return colors.fg_urgent.get();
+    default:
+      return colors.foreground.get();
+  }
+}
+
 
-SectionPixmap::SectionPixmap(DS::pixmap_t pixmap, BarColors* colors,
+SectionPixmap::SectionPixmap(const DS::window_t* window, BarColors* colors,
                              uint16_t width, uint16_t height)
     : _used(0)
     , _width(width)
     , _height(height)
     , _ds(DS::Instance())
     , _colors(colors)
-    , _pixmap(std::move(pixmap))
-    , _xft_draw(_pixmap.create_xft_draw()) {
+    , _window(window)
+    , _pixmap(_window->create_pixmap(std::min(width, initial_pixmap_width))) {
+  if constexpr (RENDER_BACKEND == render_backend_e::SHM) {
+    _image = _ds.create_image(_pixmap.width(), _height);
+  } else if constexpr (RENDER_BACKEND == render_backend_e::XFT) {
+    _xft_draw = _pixmap.create_xft_draw();
+  }
+  clear();
+}
+
+
+SectionPixmap::~SectionPixmap() {
+  if (_xft_draw != nullptr) {
+    XftDrawDestroy(_xft_draw);
+  }
 }
 
 
@@ -75,7 +110,77 @@ void
 SectionPixmap::clear() {
   _used = 0;
   _areas = std::vector<area_t>();
-  _pixmap.clear();
+  _runs.clear();
+  if constexpr (RENDER_BACKEND == render_backend_e::SHM) {
+    auto raster = _image->raster();
+    raster.fill(*_colors->background.val(), 0, raster.width);
+  } else {
+    _pixmap.clear();
+  }
+}
+
+
+/** resize
+ * Follow a change in size of the bar, e.g. after it was moved to a monitor of a
+ * different size. Like clear(), this drops everything written so far.
+ */
+void
+SectionPixmap::resize(uint16_t width, uint16_t height) {
+  _width = width;
+  _height = height;
+  set_pixmap(_window->create_pixmap(std::min(_pixmap.width(), width)), 0);
+  clear();
+}
+
+
+/** reserve
+ * Make sure the first `size` pixels can be drawn to, keeping what has been
+ * drawn so far.
+ */
+void
+SectionPixmap::reserve(uint16_t size) {
+  if (size <= _pixmap.width()) {
+    return;
+  }
+
+  const auto width = static_cast<uint16_t>(
+      std::min<uint32_t>(_width, std::max<uint32_t>(size, _pixmap.width() * 2)));
+  set_pixmap(_window->create_pixmap(width), _pixmap.width());
+  report_pixmap_usage();
+}
+
+
+/** set_pixmap
+ * Draw into `pixmap` from now on, keeping the first `keep` pixels of what has
+ * been drawn so far.
+ */
+void
+SectionPixmap::set_pixmap(DS::pixmap_t pixmap, uint16_t keep) {
+  if constexpr (RENDER_BACKEND == render_backend_e::SHM) {
+    auto image = _ds.create_image(pixmap.width(), _height);
+    auto dst = image.raster();
+    dst.fill(*_colors->background.val(), 0, dst.width);
+    if (keep > 0) {
+      const auto src = _image->raster();
+      const uint16_t rows = std::min(src.height, dst.height);
+      for (uint16_t row = 0; row < rows; ++row) {
+        std::copy_n(src.pixels + row * src.stride,
+                    std::min({keep, src.width, dst.width}),
+                    dst.pixels + row * dst.stride);
+      }
+    }
+    _image = std::move(image);
+  } else {
+    if (keep > 0) {
+      pixmap.clear();
+      pixmap.copy_from(_pixmap, {0, 0}, {0, 0}, keep, _height);
+    }
+    if (_xft_draw != nullptr) {
+      XftDrawDestroy(_xft_draw);
+      _xft_draw = pixmap.create_xft_draw();
+    }
+  }
+  _pixmap = std::move(pixmap);
 }
 
 
@@ -111,12 +216,21 @@ SectionPixmap::write(const segment_t& seg, uint8_t padding) {
     const uint16_t end = _used + total_size;
     _areas.push_back({.begin = _used, .end = end, .action = *seg.action});
   }
+  reserve(_used + total_size);
   _used += padding;
   for (auto&& [string, text_seg] : ranges::views::zip(strings, seg.segments)) {
     const auto& [str, font, size] = string;
-    FontColor* color = text_seg.color == NORMAL_COLOR ? &_colors->foreground
-                                                      : &_colors->fg_accent;
-    font->draw_ucs2(_xft_draw, color, str, _height, _used);
+    FontColor* color = font_color(*_colors, text_seg.color);
+    if constexpr (RENDER_BACKEND == render_backend_e::SHM) {
+      font->draw_ucs2(_image->raster(), color, str, _height, _used);
+    } else if constexpr (RENDER_BACKEND == render_backend_e::GLYPHSET) {
+      _runs.push_back({.font = font,
+                       .color = color,
+                       .x = static_cast<int16_t>(_used),
+                       .str = str});
+    } else {
+      font->draw_ucs2(_xft_draw, color, str, _height, _used);
+    }
     _used += size;
   }
   _used += padding;
@@ -129,6 +243,21 @@ SectionPixmap::write(const segment_t& seg, uint8_t padding) {
 void
 SectionPixmap::pad(uint8_t padding) {
   _used = std::min<decltype(_used)>(_used + padding, _width);
+  reserve(_used);
+}
+
+
+/** finish
+ * Called once everything has been written. Uploads the client side image when
+ * rendering with SHM, draws the collected text with GLYPHSET.
+ */
+void
+SectionPixmap::finish() {
+  if constexpr (RENDER_BACKEND == render_backend_e::SHM) {
+    _image->put(_pixmap, _used);
+  } else if constexpr (RENDER_BACKEND == render_backend_e::GLYPHSET) {
+    _pixmap.draw_glyphs(_runs);
+  }
 }
 
 
@@ -158,6 +287,21 @@ SectionPixmap::click(int16_t x, uint8_t button) const {
 }
 
 
+/** report_pixmap_usage
+ * Let the profiler know how much server memory our pixmaps take up.
+ */
+void
+report_pixmap_usage() {
+  auto& profiler = Profiler::Instance();
+  if (!profiler.verbose()) {
+    return;
+  }
+  if (auto bytes = DS::Instance().get_pixmap_bytes()) {
+    profiler.report_usage("server pixmap memory", *bytes);
+  }
+}
+
+
 /** pipe operator
  * write() the segments from a generator one at a time.
  */
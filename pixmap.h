@@ -1,5 +1,6 @@
 #pragma once
 
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -7,11 +8,20 @@
 #include "config.h"
 #include "types.h"
 
+/** SectionPixmap
+ * Server side image of one section. The pixmap starts out narrow and grows
+ * geometrically up to the width of the bar, so it stays close to the widest
+ * content the section has had.
+ *
+ * With the SHM backend the section is drawn into a client side image of the
+ * same size instead, which finish() uploads into the pixmap. With GLYPHSET the
+ * text is collected and finish() draws all of it at once.
+ */
 class SectionPixmap {
  public:
-  SectionPixmap(DS::pixmap_t pixmap, BarColors* colors, uint16_t width,
+  SectionPixmap(const DS::window_t* window, BarColors* colors, uint16_t width,
                 uint16_t height);
-  ~SectionPixmap() = default;
+  ~SectionPixmap();
   SectionPixmap(const SectionPixmap&) = delete;
   SectionPixmap(SectionPixmap&&) = delete;
   SectionPixmap& operator=(const SectionPixmap&) = delete;
@@ -21,8 +31,10 @@ class SectionPixmap {
   [[nodiscard]] const DS::pixmap_t& pixmap() const { return _pixmap; }
 
   void clear();
+  void resize(uint16_t width, uint16_t height);
   void write(const segment_t& seg, uint8_t padding = 0);
   void pad(uint8_t padding);
+  void finish();
 
   /* auto with_padding(uint8_t padding) */
   /*     -> std::function<void(const segment_t&)>; */
@@ -30,14 +42,22 @@ class SectionPixmap {
   void click(int16_t x, uint8_t button) const;
 
  private:
+  void reserve(uint16_t size);
+  void set_pixmap(DS::pixmap_t pixmap, uint16_t keep);
+
   uint16_t _used;
   uint16_t _width, _height;
   DS& _ds;
   BarColors* _colors;
+  const DS::window_t* _window;
   DS::pixmap_t _pixmap;
-  XftDraw* _xft_draw;
+  XftDraw* _xft_draw{nullptr};          // only used by XFT
+  std::optional<DS::image_t> _image;  // only used by SHM
+  std::vector<glyph_run_t> _runs;     // only used by GLYPHSET
   std::vector<area_t> _areas;
 };
 
+void report_pixmap_usage();
+
 void operator|(cppcoro::generator<const segment_t&> generator,
                SectionPixmap& pixmap);
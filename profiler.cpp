@@ -0,0 +1,76 @@
+#include "profiler.h"
+
+#include <cstdlib>
+#include <iostream>
+
+
+static constexpr std::array<const char*,
+                            static_cast<size_t>(milestone_e::COUNT)>
+    milestone_names{
+        "time to first paint",
+        "time to complete content",
+    };
+
+static constexpr std::array<const char*, static_cast<size_t>(counter_e::COUNT)>
+    counter_names{
+        "suppressed_updates",
+        "paints",
+        "ipc_messages",
+        "missed_deadlines",
+    };
+
+
+Profiler::Profiler()
+    : _start(clock::now()), _verbose(getenv("LIMEBAR_PROFILE") != nullptr) {
+}
+
+Profiler&
+Profiler::Instance() {
+  static Profiler instance;
+  return instance;
+}
+
+
+void
+Profiler::painted() {
+  count(counter_e::PAINTS);
+  mark(milestone_e::FIRST_PAINT);
+  if (_loading == 0) {
+    mark(milestone_e::CONTENT_COMPLETE);
+  }
+}
+
+
+const char*
+Profiler::name(counter_e counter) {
+  return counter_names[static_cast<size_t>(counter)];
+}
+
+
+/** report_usage
+ * Print how many bytes of `resource` are in use.
+ */
+void
+Profiler::report_usage(const char* resource, uint64_t bytes) const {
+  if (_verbose) {
+    std::cerr << resource << ": " << bytes << " bytes\n";
+  }
+}
+
+
+/** mark
+ * Record the first time `milestone` is reached.
+ */
+void
+Profiler::mark(milestone_e milestone) {
+  auto& time = _milestones[static_cast<size_t>(milestone)];
+  if (time) {
+    return;
+  }
+  time = clock::now() - _start;
+  if (_verbose) {
+    std::cerr << milestone_names[static_cast<size_t>(milestone)] << ": "
+              << std::chrono::duration<double, std::milli>(*time).count()
+              << "ms\n";
+  }
+}
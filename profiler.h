@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <optional>
+
+
+enum class milestone_e : uint8_t {
+  FIRST_PAINT,       // the first time any bar was drawn
+  CONTENT_COMPLETE,  // the first paint after every module had its content
+  COUNT,
+};
+
+enum class counter_e : uint8_t {
+  SUPPRESSED_UPDATES,  // module updates which didn't change its segments
+  PAINTS,              // bars drawn
+  IPC_MESSAGES,        // messages received over the control socket
+  MISSED_DEADLINES,    // asynchronous module jobs which took too long
+  COUNT,
+};
+
+
+/** Profiler
+ * Process wide record of how long startup took. Milestones are measured from
+ * the creation of the profiler, which should be the first thing main() does.
+ * If LIMEBAR_PROFILE is set in the environment each milestone is also printed
+ * to stderr as it is reached.
+ */
+class Profiler {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  static Profiler& Instance();
+
+  Profiler(const Profiler&) = delete;
+  Profiler(Profiler&&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+  Profiler& operator=(Profiler&&) = delete;
+  ~Profiler() = default;
+
+  // Content which the CONTENT_COMPLETE milestone waits on. May be called from
+  // any thread.
+  void begin_load() { ++_loading; }
+  void end_load() { --_loading; }
+
+  // Called whenever a bar has been drawn.
+  void painted();
+
+  // Counters may only be used from the render thread.
+  void count(counter_e counter) { ++_counters[static_cast<size_t>(counter)]; }
+  [[nodiscard]] uint64_t counter(counter_e counter) const {
+    return _counters[static_cast<size_t>(counter)];
+  }
+  [[nodiscard]] static const char* name(counter_e counter);
+
+  // Resource usage is only worth measuring if it is going to be reported.
+  [[nodiscard]] bool verbose() const { return _verbose; }
+  void report_usage(const char* resource, uint64_t bytes) const;
+
+ private:
+  Profiler();
+
+  void mark(milestone_e milestone);
+
+  clock::time_point _start;
+  bool _verbose;
+  std::atomic<int> _loading{0};
+  std::array<std::optional<clock::duration>,
+             static_cast<size_t>(milestone_e::COUNT)>
+      _milestones;
+  std::array<uint64_t, static_cast<size_t>(counter_e::COUNT)> _counters{};
+};
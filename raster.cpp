@@ -0,0 +1,123 @@
+#include "raster.h"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/** fill
+ * Set columns [x, x + w) of every row to `pixel`.
+ */
+void
+raster_t::fill(uint32_t pixel, uint16_t x, uint16_t w) {
+  w = std::min<uint16_t>(w, width - std::min(x, width));
+  for (uint16_t row = 0; row < height; ++row) {
+    std::fill_n(pixels + row * stride + x, w, pixel);
+  }
+}
+
+
+/** blend_glyph
+ * Composite `glyph` in `color` over the raster with its pen position at
+ * {x,y}, clipping it to the raster.
+ */
+void
+blend_glyph(raster_t raster, const glyph_bitmap_t& glyph, int x, int y,
+            uint32_t color) {
+  const int left = x + glyph.left;
+  const int top = y - glyph.top;
+  const int skip_x = std::max(0, -left);
+  const int skip_y = std::max(0, -top);
+  const int w = std::min<int>(glyph.width, raster.width - left) - skip_x;
+  const int h = std::min<int>(glyph.height, raster.height - top) - skip_y;
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+
+  for (int row = skip_y; row < skip_y + h; ++row) {
+    blend_span(raster.pixels + (top + row) * raster.stride + left + skip_x,
+               glyph.coverage.data() + row * glyph.width + skip_x,
+               static_cast<size_t>(w), color);
+  }
+}
+
+
+// (a * b) / 255 rounded, for a and b in [0, 255]
+static inline uint32_t
+mul_255(uint32_t a, uint32_t b) {
+  const uint32_t t = a * b + 128;
+  return (t + (t >> 8)) >> 8;
+}
+
+
+/** blend_span
+ * dst = color * coverage + dst * (1 - alpha(color) * coverage) for n pixels,
+ * all premultiplied. Four pixels are blended at a time where SSE2 is
+ * available.
+ */
+void
+blend_span(uint32_t* dst, const uint8_t* coverage, size_t n, uint32_t color) {
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i half = _mm_set1_epi16(128);
+  const __m128i full = _mm_set1_epi16(255);
+  // the color once per pixel, widened to 16 bits per channel
+  const __m128i src = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(color)), zero);
+  const auto src_alpha = static_cast<int16_t>(color >> 24);
+
+  // (x * y) / 255 rounded, on 16 bit lanes
+  const auto mul = [half](__m128i x, __m128i y) {
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), half);
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+  };
+
+  for (; i + 4 <= n; i += 4) {
+    uint32_t cov4;
+    std::copy_n(coverage + i, 4, reinterpret_cast<uint8_t*>(&cov4));
+    if (cov4 == 0) {
+      continue;
+    }
+
+    // spread each pixel's coverage over its four channels
+    __m128i cov = _mm_cvtsi32_si128(static_cast<int>(cov4));
+    cov = _mm_unpacklo_epi8(cov, zero);
+    cov = _mm_unpacklo_epi16(cov, cov);
+    const __m128i cov_lo = _mm_unpacklo_epi32(cov, cov);
+    const __m128i cov_hi = _mm_unpackhi_epi32(cov, cov);
+
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    const __m128i d_lo = _mm_unpacklo_epi8(d, zero);
+    const __m128i d_hi = _mm_unpackhi_epi8(d, zero);
+
+    const __m128i s_lo = mul(src, cov_lo);
+    const __m128i s_hi = mul(src, cov_hi);
+    const __m128i inv_lo =
+        _mm_sub_epi16(full, mul(_mm_set1_epi16(src_alpha), cov_lo));
+    const __m128i inv_hi =
+        _mm_sub_epi16(full, mul(_mm_set1_epi16(src_alpha), cov_hi));
+
+    d = _mm_packus_epi16(_mm_add_epi16(s_lo, mul(d_lo, inv_lo)),
+                         _mm_add_epi16(s_hi, mul(d_hi, inv_hi)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), d);
+  }
+#endif
+
+  for (; i < n; ++i) {
+    const uint32_t c = coverage[i];
+    if (c == 0) {
+      continue;
+    }
+    const uint32_t inv = 255 - mul_255(color >> 24, c);
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      const uint32_t s = (color >> shift) & 0xff;
+      const uint32_t d = (dst[i] >> shift) & 0xff;
+      out |= std::min<uint32_t>(255, mul_255(s, c) + mul_255(d, inv)) << shift;
+    }
+    dst[i] = out;
+  }
+}
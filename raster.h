@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <vector>
+
+
+/** raster_t
+ * A client side image in the server's 32 bit ZPixmap layout, i.e. premultiplied
+ * 0xAARRGGBB pixels. Rows are `stride` pixels apart.
+ */
+struct raster_t {
+  uint32_t* pixels;
+  uint16_t stride;
+  uint16_t width;
+  uint16_t height;
+
+  void fill(uint32_t pixel, uint16_t x, uint16_t w);
+};
+
+
+/** glyph_bitmap_t
+ * The coverage of a rasterized glyph, one byte per pixel. {left,top} is the
+ * offset of the top left pixel from the pen position on the baseline.
+ */
+struct glyph_bitmap_t {
+  int16_t left{0};
+  int16_t top{0};
+  uint16_t width{0};
+  uint16_t height{0};
+  std::vector<uint8_t> coverage;
+};
+
+
+void blend_glyph(raster_t raster, const glyph_bitmap_t& glyph, int x, int y,
+                 uint32_t color);
+void blend_span(uint32_t* dst, const uint8_t* coverage, size_t n,
+                uint32_t color);
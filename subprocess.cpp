@@ -0,0 +1,103 @@
+#include "subprocess.h"
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <vector>
+
+extern char** environ;
+
+
+/** spawn_shell
+ * posix_spawn() the command instead of forking, so that starting it neither
+ * copies the page tables of the bar nor depends on its size: glibc spawns with
+ * vfork semantics, sharing the address space until the exec.
+ */
+std::optional<child_t>
+spawn_shell(const char* command, const char* env) {
+  std::array<int, 2> pipe_fds;
+  if (pipe2(pipe_fds.data(), O_CLOEXEC) == -1) {
+    return std::nullopt;
+  }
+  fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+  // stdin may be what mod_lemon reads from, which the child mustn't consume
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+                                   O_RDONLY, 0);
+
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  sigset_t signals;
+  sigemptyset(&signals);
+  posix_spawnattr_setsigmask(&attr, &signals);
+  posix_spawnattr_setpgroup(&attr, 0);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK |
+                                      POSIX_SPAWN_SETPGROUP);
+
+  std::vector<char*> environment;
+  for (char** var = environ; *var != nullptr; ++var) {
+    environment.push_back(*var);
+  }
+  if (env != nullptr) {
+    environment.push_back(const_cast<char*>(env));
+  }
+  environment.push_back(nullptr);
+
+  std::array<const char*, 4> argv{"sh", "-c", command, nullptr};
+  pid_t pid;
+  const int error =
+      posix_spawn(&pid, "/bin/sh", &actions, &attr,
+                  const_cast<char* const*>(argv.data()), environment.data());
+
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  close(pipe_fds[1]);
+  if (error != 0) {
+    close(pipe_fds[0]);
+    return std::nullopt;
+  }
+
+  const auto pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+  return child_t{.pid = pid, .output = pipe_fds[0], .pidfd = pidfd};
+}
+
+void
+kill_child(const child_t& child) {
+  kill(-child.pid, SIGKILL);
+}
+
+static void
+close_child(const child_t& child) {
+  close(child.output);
+  if (child.pidfd != -1) {
+    close(child.pidfd);
+  }
+}
+
+int
+reap_child(const child_t& child) {
+  int status = 0;
+  waitpid(child.pid, &status, 0);
+  close_child(child);
+  return status;
+}
+
+std::optional<int>
+try_reap_child(const child_t& child) {
+  int status = 0;
+  const pid_t pid = waitpid(child.pid, &status, WNOHANG);
+  if (pid == 0 || (pid == -1 && errno == EINTR)) {
+    return std::nullopt;
+  }
+  close_child(child);
+  return status;
+}
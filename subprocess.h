@@ -0,0 +1,31 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <optional>
+
+
+/** child_t
+ * A command started by spawn_shell(), with stdin from /dev/null. `output` is
+ * the non-blocking read end of its stdout and `pidfd` becomes readable once it
+ * has exited (-1 where the kernel doesn't support pidfds). The child leads its
+ * own process group so that it can be killed together with everything it
+ * started.
+ */
+struct child_t {
+  pid_t pid;
+  int output;
+  int pidfd;
+};
+
+// Run `command` with /bin/sh. `env` is added to the environment of the child.
+std::optional<child_t> spawn_shell(const char* command,
+                                   const char* env = nullptr);
+// Kill the child and everything it started.
+void kill_child(const child_t& child);
+// Reap the child, waiting for it to exit, and close its file descriptors.
+// Returns its wait status.
+int reap_child(const child_t& child);
+// Like reap_child(), but returns std::nullopt without waiting while the child
+// is still running.
+std::optional<int> try_reap_child(const child_t& child);
@@ -1,8 +1,18 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <optional>
 #include <tuple>
+#include <utility>  // exchange
 /* #include <concepts> */
 
+#include "event_loop.h"
+#include "modules/module.h"
+#include "profiler.h"
+#include "thread_pool.h"
+
 
 template <typename T>
 concept Taskable = requires(T t) {
@@ -12,12 +22,47 @@ concept Taskable = requires(T t) {
   t.do_work();
 };
 
+template <typename T>
+concept Publishable = Taskable<T> && requires(T t) {
+  t.publish();
+};
+
+template <typename T>
+concept Startable = Taskable<T> && requires(T t, EventLoop* loop) {
+  t.start(loop);
+};
+
 template <typename T>
 concept Downstream = requires(T t) {
   t.update();
 };
 
 
+/** ChangeFilter
+ * Remembers the fingerprint of a module's segments so that the downstream
+ * update can be skipped when do_work() produced exactly what is already drawn,
+ * e.g. when a window manager re-asserts the active window. Anything which isn't
+ * a module always counts as changed.
+ */
+template <typename T>
+class ChangeFilter {
+ public:
+  bool changed(const T& t) {
+    if constexpr (requires { t.get(); }) {
+      const uint64_t hash = fingerprint(t);
+      if (std::exchange(_fingerprint, hash) == hash) {
+        Profiler::Instance().count(counter_e::SUPPRESSED_UPDATES);
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  std::optional<uint64_t> _fingerprint;
+};
+
+
 /** Task
  * A greedy task meant for asynchronous use which immediately runs any work it
  * has and updates the downstream when there is no more work to do on itself.
@@ -36,7 +81,9 @@ class Task {
       do_work();
     } while (has_work());
 
-    update();
+    if (_filter.changed(*_task)) {
+      update();
+    }
   }
 
  protected:
@@ -49,17 +96,179 @@ class Task {
  private:
   T* _task;
   std::tuple<D*...> _downstream;
+  ChangeFilter<T> _filter;
 };
 
 
 /** TaskModule
  * A specialization of Task that runs the task on construction. Useful for
- * modules to get their initial values.
+ * modules to get their initial values. The initial run happens on its own
+ * thread so that all modules load concurrently; ready() has to be called
+ * before anything reads from the module (see wait_ready()).
  */
 template <Taskable T, Downstream... D>
 class ModuleTask : public Task<T, D...> {
  public:
-  explicit ModuleTask(T* t, D*... d) : Task<T, D...>(t, d...) {
+  explicit ModuleTask(T* t, D*... d)
+      : Task<T, D...>(t, d...)
+      , _initial(std::async(std::launch::async, [t] { t->do_work(); })) {
+    Profiler::Instance().begin_load();
+  }
+
+  void ready() {
+    if (_initial.valid()) {
+      _initial.get();
+      Profiler::Instance().end_load();
+    }
+  }
+
+  void work() {
+    ready();
+    Task<T, D...>::work();
+  }
+
+ private:
+  std::future<void> _initial;
+};
+
+
+/** CoroutineModuleTask
+ * A specialization of Task that starts a CoroutineModule (or any other module
+ * driven by the event loop, like a PeriodicModule) on the event loop. The
+ * module runs up to its first suspension right away, so anything it produces
+ * before waiting on an event is available for the first paint.
+ */
+template <Startable T, Downstream... D>
+class CoroutineModuleTask : public Task<T, D...> {
+ public:
+  explicit CoroutineModuleTask(EventLoop* loop, T* t, D*... d)
+      : Task<T, D...>(t, d...) {
+    t->start(loop);
     Task<T, D...>::do_work();
   }
 };
+
+
+/** AsyncModuleTask
+ * A ModuleTask whose do_work() runs on a ThreadPool so that a slow module can
+ * never stall clicks or redraws of the other modules. has_work() is still
+ * polled on the render thread; work that arrives while a job is in flight is
+ * coalesced into a single follow-up job. Finished jobs are published and the
+ * downstream updated on the render thread, so until then the last good
+ * snapshot of the module keeps being drawn.
+ *
+ * Every job gets `deadline` to finish. The initial one is waited on by ready()
+ * for at most that long, so that the first paint normally has the module's
+ * content without being held up by it. A job which misses its deadline is
+ * counted (MISSED_DEADLINES) and the previous snapshot stays up until the job
+ * finishes; it can't be abandoned as it writes to the module itself. Finished
+ * jobs and deadlines both wake the EventLoop, so nothing polls for them.
+ */
+template <Publishable T, Downstream... D>
+class AsyncModuleTask {
+ public:
+  using clock = EventLoop::clock;
+
+  explicit AsyncModuleTask(ThreadPool* pool, EventLoop* loop,
+                           std::chrono::milliseconds deadline, T* t, D*... d)
+      : _pool(pool)
+      , _loop(loop)
+      , _deadline(deadline)
+      , _task(t)
+      , _downstream(d...) {
+    Profiler::Instance().begin_load();
+    submit();
+  }
+
+  void ready() {
+    if (!_loaded && _job.wait_for(_deadline) == std::future_status::ready) {
+      finish();
+    }
+  }
+
+  void work() {
+    while (_task->has_work()) {
+      _pending = true;
+    }
+
+    if (_job.valid()) {
+      if (_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        if (!_overdue && clock::now() >= _due) {
+          _overdue = true;
+          Profiler::Instance().count(counter_e::MISSED_DEADLINES);
+        }
+        return;
+      }
+      finish();
+      if (_filter.changed(*_task)) {
+        update();
+      }
+    }
+
+    if (_pending) {
+      _pending = false;
+      submit();
+    }
+  }
+
+ private:
+  void submit() {
+    _job = _pool->submit([task = _task, loop = _loop] {
+      task->do_work();
+      // the main loop picks the result up once it is woken
+      loop->wake();
+    });
+    _due = clock::now() + _deadline;
+    _overdue = false;
+    // only there to wake the main loop, work() checks the deadline itself.
+    // The slack is as long as a deadline, so the timer has to be exact.
+    _timer = _loop->timers().add_exact(_due, [] {});
+  }
+
+  void finish() {
+    _job.get();
+    _loop->timers().cancel(_timer);
+    _task->publish();
+    if (!_loaded) {
+      _loaded = true;
+      Profiler::Instance().end_load();
+    }
+  }
+
+  void update() {
+    std::apply([](D*... d) { ((d->update()), ...); }, _downstream);
+  }
+
+  ThreadPool* _pool;
+  EventLoop* _loop;
+  std::chrono::milliseconds _deadline;
+  T* _task;
+  std::tuple<D*...> _downstream;
+  std::future<void> _job;
+  clock::time_point _due;
+  TimerWheel::timer_id _timer{0};
+  ChangeFilter<T> _filter;
+  bool _pending{false};
+  bool _loaded{false};
+  bool _overdue{false};
+};
+
+
+/** wait_ready
+ * Wait for the initial work of every task which has any. That work was started
+ * concurrently when the tasks were constructed.
+ */
+template <typename... Tasks>
+void
+wait_ready(std::tuple<Tasks...>& tasks) {
+  std::apply(
+      [](auto&... task) {
+        (([&] {
+           if constexpr (requires { task.ready(); }) {
+             task.ready();
+           }
+         }()),
+         ...);
+      },
+      tasks);
+}
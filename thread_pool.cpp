@@ -0,0 +1,57 @@
+#include "thread_pool.h"
+
+#include <utility>
+
+
+ThreadPool::ThreadPool(size_t threads) {
+  _workers.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    _workers.emplace_back([this] { worker(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::scoped_lock lock(_mutex);
+    _stopping = true;
+  }
+  _cv.notify_all();
+  for (auto& thread : _workers) {
+    thread.join();
+  }
+}
+
+
+/** submit
+ * Queue `job` to be run on the next free worker. The returned future becomes
+ * ready once the job has finished and rethrows anything the job threw.
+ */
+std::future<void>
+ThreadPool::submit(std::function<void()>&& job) {
+  std::packaged_task<void()> task(std::move(job));
+  auto future = task.get_future();
+  {
+    std::scoped_lock lock(_mutex);
+    _jobs.push_back(std::move(task));
+  }
+  _cv.notify_one();
+  return future;
+}
+
+
+void
+ThreadPool::worker() {
+  while (true) {
+    std::packaged_task<void()> job;
+    {
+      std::unique_lock lock(_mutex);
+      _cv.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+      if (_jobs.empty()) {
+        return;
+      }
+      job = std::move(_jobs.front());
+      _jobs.pop_front();
+    }
+    job();
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>  // size_t
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/** ThreadPool
+ * A small, fixed set of worker threads which run submitted jobs in the order
+ * they were received. Used to keep slow work off of the render loop.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  std::future<void> submit(std::function<void()>&& job);
+
+ private:
+  void worker();
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::deque<std::packaged_task<void()>> _jobs;
+  std::vector<std::thread> _workers;
+  bool _stopping{false};
+};
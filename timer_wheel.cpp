@@ -0,0 +1,268 @@
+#include "timer_wheel.h"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+
+
+TimerWheel::TimerWheel(clock::duration slack)
+    : _fd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+    , _epoch(clock::now())
+    , _slack(std::max<tick_t>(
+          1, std::chrono::ceil<std::chrono::milliseconds>(slack).count())) {
+  if (_fd == -1) {
+    std::cerr << "Couldn't create timerfd\n";
+    exit(EXIT_FAILURE);
+  }
+}
+
+TimerWheel::~TimerWheel() {
+  close(_fd);
+}
+
+
+/** add
+ * Register a one shot timer which fires once `deadline` has passed.
+ */
+auto
+TimerWheel::add(clock::time_point deadline, callback_t&& callback) -> timer_id {
+  return insert({.deadline = to_tick(deadline),
+                 .period = 0,
+                 .callback = std::move(callback)});
+}
+
+/** add
+ * Register a periodic timer which fires at `first` and then every `period`.
+ */
+auto
+TimerWheel::add(clock::time_point first, clock::duration period,
+                callback_t&& callback) -> timer_id {
+  const auto ms = std::chrono::ceil<std::chrono::milliseconds>(period).count();
+  return insert({.deadline = to_tick(first),
+                 .period = std::max<tick_t>(1, ms),
+                 .callback = std::move(callback)});
+}
+
+/** add_exact
+ * Register a one shot timer which fires as soon as `deadline` has passed,
+ * without waiting for the end of its slack window.
+ */
+auto
+TimerWheel::add_exact(clock::time_point deadline, callback_t&& callback)
+    -> timer_id {
+  return insert({.deadline = to_tick(deadline),
+                 .period = 0,
+                 .callback = std::move(callback),
+                 .exact = true});
+}
+
+void
+TimerWheel::cancel(timer_id id) {
+  // the id is left in its slot and skipped once that slot is visited
+  if (auto itr = _timers.find(id); itr != _timers.end()) {
+    _exact_timers -= itr->second.exact ? 1 : 0;
+    _timers.erase(itr);
+    rearm();
+  }
+}
+
+
+/** expire
+ * Advance the wheel to the current time and run the callbacks of every timer
+ * that is due. Periodic timers are rescheduled to the first multiple of their
+ * period after now, which keeps them aligned to their original phase.
+ */
+void
+TimerWheel::expire() {
+  uint64_t expirations = 0;
+  while (read(_fd, &expirations, sizeof(expirations)) > 0) {
+  }
+  _armed.reset();
+
+  const auto elapsed = std::chrono::floor<std::chrono::milliseconds>(
+      clock::now() - _epoch);
+  std::vector<timer_id> due;
+  advance(std::max<tick_t>(_now, elapsed.count()), due);
+
+  for (timer_id id : due) {
+    auto itr = _timers.find(id);
+    if (itr == _timers.end()) {
+      continue;  // cancelled by an earlier callback
+    }
+
+    auto& timer = itr->second;
+    if (timer.period == 0) {
+      callback_t callback = std::move(timer.callback);
+      _exact_timers -= timer.exact ? 1 : 0;
+      _timers.erase(itr);
+      callback();
+    } else {
+      const tick_t missed = (_now - timer.deadline) / timer.period + 1;
+      timer.deadline += missed * timer.period;
+      place(id, timer.deadline);
+      callback_t callback = timer.callback;
+      callback();
+    }
+  }
+
+  rearm();
+}
+
+
+/** next_wakeup
+ * The time at which the timerfd will next fire, if any timer is pending.
+ */
+auto
+TimerWheel::next_wakeup() const -> std::optional<clock::time_point> {
+  std::optional<tick_t> earliest;
+  std::optional<tick_t> earliest_exact;
+  for (size_t level = 0; level < LEVELS; ++level) {
+    const size_t shift = level * SLOT_BITS;
+    std::optional<tick_t> level_earliest;
+    std::optional<tick_t> level_exact;
+    for (size_t i = 0; i < SLOTS; ++i) {
+      const auto& slot = _wheel[level][((_now >> shift) + i) % SLOTS];
+      for (timer_id id : slot) {
+        if (auto itr = _timers.find(id); itr != _timers.end()) {
+          const tick_t deadline = itr->second.deadline;
+          level_earliest =
+              std::min(level_earliest.value_or(deadline), deadline);
+          if (itr->second.exact) {
+            level_exact = std::min(level_exact.value_or(deadline), deadline);
+          }
+        }
+      }
+      // slots are ordered by time within a level, so the first occupied slot
+      // holds the earliest deadline of the level and the first slot with an
+      // exact timer the earliest exact one
+      if (level_earliest && (level_exact || _exact_timers == 0)) {
+        break;
+      }
+    }
+    if (level_earliest) {
+      earliest = std::min(earliest.value_or(*level_earliest), *level_earliest);
+    }
+    if (level_exact) {
+      earliest_exact =
+          std::min(earliest_exact.value_or(*level_exact), *level_exact);
+    }
+  }
+
+  if (!earliest) {
+    return std::nullopt;
+  }
+  tick_t wakeup = (std::max(*earliest, _now) + _slack - 1) / _slack * _slack;
+  if (earliest_exact) {
+    wakeup = std::min(wakeup, std::max(*earliest_exact, _now));
+  }
+  return from_tick(wakeup);
+}
+
+
+auto
+TimerWheel::to_tick(clock::time_point time) const -> tick_t {
+  if (time <= _epoch) {
+    return 0;
+  }
+  return std::chrono::ceil<std::chrono::milliseconds>(time - _epoch).count();
+}
+
+auto
+TimerWheel::from_tick(tick_t tick) const -> clock::time_point {
+  return _epoch + std::chrono::milliseconds(tick);
+}
+
+
+auto
+TimerWheel::insert(timer_t&& timer) -> timer_id {
+  const timer_id id = _next_id++;
+  const tick_t deadline = timer.deadline;
+  _exact_timers += timer.exact ? 1 : 0;
+  _timers.emplace(id, std::move(timer));
+  place(id, deadline);
+  rearm();
+  return id;
+}
+
+/** place
+ * Put the timer into the lowest level whose slots can still tell its deadline
+ * apart from now. Timers further out than the top level can represent are
+ * parked in its last slot and placed again once that slot is reached.
+ */
+void
+TimerWheel::place(timer_id id, tick_t deadline) {
+  const tick_t at = std::max(deadline, _now);
+  for (size_t level = 0; level < LEVELS; ++level) {
+    const size_t shift = level * SLOT_BITS;
+    const tick_t distance = (at >> shift) - (_now >> shift);
+    if (distance < SLOTS) {
+      _wheel[level][(at >> shift) % SLOTS].push_back(id);
+      return;
+    }
+  }
+  constexpr size_t shift = (LEVELS - 1) * SLOT_BITS;
+  _wheel[LEVELS - 1][((_now >> shift) + SLOTS - 1) % SLOTS].push_back(id);
+}
+
+/** advance
+ * Move the wheel to `target`, collecting every timer which is due into `due`
+ * and cascading the rest of the visited slots down to the lower levels.
+ */
+void
+TimerWheel::advance(tick_t target, std::vector<timer_id>& due) {
+  const tick_t previous = _now;
+  _now = target;
+
+  for (size_t level = LEVELS; level-- > 0;) {
+    const size_t shift = level * SLOT_BITS;
+    const tick_t first = previous >> shift;
+    const tick_t count = std::min<tick_t>((target >> shift) - first + 1, SLOTS);
+
+    for (tick_t i = 0; i < count; ++i) {
+      slot_t slot;
+      std::swap(slot, _wheel[level][(first + i) % SLOTS]);
+      for (timer_id id : slot) {
+        auto itr = _timers.find(id);
+        if (itr == _timers.end()) {
+          continue;
+        }
+        if (itr->second.deadline <= target) {
+          due.push_back(id);
+        } else {
+          place(id, itr->second.deadline);
+        }
+      }
+    }
+  }
+}
+
+/** rearm
+ * Point the timerfd at the next wakeup, or disarm it if nothing is pending.
+ */
+void
+TimerWheel::rearm() {
+  const auto wakeup = next_wakeup();
+  const auto tick =
+      wakeup ? std::optional<tick_t>(to_tick(*wakeup)) : std::nullopt;
+  if (tick == _armed) {
+    return;
+  }
+  _armed = tick;
+
+  itimerspec spec{};
+  if (wakeup) {
+    const auto since_boot = wakeup->time_since_epoch();
+    const auto secs = std::chrono::floor<std::chrono::seconds>(since_boot);
+    spec.it_value.tv_sec = secs.count();
+    spec.it_value.tv_nsec =
+        std::chrono::nanoseconds(since_boot - secs).count();
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+      spec.it_value.tv_nsec = 1;  // a zero value would disarm the timer
+    }
+  }
+  timerfd_settime(_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>  // size_t
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+
+/** TimerWheel
+ * A hierarchical timing wheel driven by a single timerfd, shared by everything
+ * that needs to run periodically.
+ *
+ * Wakeups are rounded up to a multiple of `slack`, so deadlines which fall into
+ * the same slack window are fired together by one wakeup. Periodic timers are
+ * rescheduled relative to their previous deadline rather than to when they
+ * actually fired, so they keep their phase no matter how late they were.
+ * Exact timers are the exception to the slack: something is waiting on them,
+ * e.g. a deferred frame, so they are fired at their deadline.
+ */
+class TimerWheel {
+ public:
+  using clock = std::chrono::steady_clock;
+  using callback_t = std::function<void()>;
+  using timer_id = uint64_t;
+
+  explicit TimerWheel(clock::duration slack);
+  ~TimerWheel();
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel(TimerWheel&&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+  TimerWheel& operator=(TimerWheel&&) = delete;
+
+  timer_id add(clock::time_point deadline, callback_t&& callback);
+  timer_id add(clock::time_point first, clock::duration period,
+               callback_t&& callback);
+  timer_id add_exact(clock::time_point deadline, callback_t&& callback);
+  void cancel(timer_id id);
+
+  // Run the callbacks of all timers which are due.
+  void expire();
+
+  [[nodiscard]] int fd() const { return _fd; }
+  [[nodiscard]] auto next_wakeup() const -> std::optional<clock::time_point>;
+
+ private:
+  using tick_t = uint64_t;  // milliseconds since _epoch
+
+  static constexpr size_t SLOT_BITS = 6;
+  static constexpr size_t SLOTS = 1U << SLOT_BITS;
+  static constexpr size_t LEVELS = 4;
+
+  struct timer_t {
+    tick_t deadline;
+    tick_t period;  // 0 for one shot timers
+    callback_t callback;
+    bool exact{false};  // not delayed by the slack
+  };
+
+  using slot_t = std::vector<timer_id>;
+
+  [[nodiscard]] tick_t to_tick(clock::time_point time) const;
+  [[nodiscard]] clock::time_point from_tick(tick_t tick) const;
+
+  timer_id insert(timer_t&& timer);
+  void place(timer_id id, tick_t deadline);
+  void advance(tick_t target, std::vector<timer_id>& due);
+  void rearm();
+
+  int _fd;
+  clock::time_point _epoch;
+  tick_t _slack;
+  tick_t _now{0};
+  timer_id _next_id{0};
+  std::optional<tick_t> _armed;
+
+  std::unordered_map<timer_id, timer_t> _timers;
+  size_t _exact_timers{0};
+  std::array<std::array<slot_t, SLOTS>, LEVELS> _wheel;
+};
@@ -23,6 +23,8 @@ struct rectangle_t {
   int16_t y{0};
   uint16_t width{0};
   uint16_t height{0};
+
+  bool operator==(const rectangle_t&) const = default;
 };
 
 struct area_t {
@@ -37,7 +39,7 @@ struct padding_t {
   uint8_t intra_module = 0;  // between segments within a module
 };
 
-enum font_color_e { NORMAL_COLOR, ACCENT_COLOR };
+enum font_color_e { NORMAL_COLOR, ACCENT_COLOR, URGENT_COLOR };
 
 struct text_segment_t {
   std::string str;
@@ -51,4 +53,7 @@ struct text_segment_t {
 struct segment_t {
   std::vector<text_segment_t> segments;
   std::optional<std::function<void(uint8_t)>> action;
+  // Identifies what the action acts on, e.g. the window it activates. Segments
+  // with equal text, colors and id must behave the same when clicked.
+  uint64_t id{0};
 };
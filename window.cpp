@@ -1,5 +1,7 @@
 #include "window.h"
 
+#include <algorithm>
+
 #include "config.h"
 #include "types.h"
 
@@ -7,20 +9,135 @@
 BarWindow::BarWindow(BarColors&& colors, rectangle_t rect)
     : _ds(DS::Instance())
     , _window(_ds.create_window(rect, colors.background, true))
-    , _pixmap(_window.create_pixmap())
     , _colors(std::move(colors))
+    , _x(rect.x)
+    , _y(rect.y)
     , _width(rect.width)
     , _height(rect.height) {
-  _window.create_gc(colors.background);
-  _pixmap.clear();
+  if constexpr (PRESENT_MODE == present_mode_e::BUFFERED) {
+    _pixmap = _window.create_pixmap();
+    _pixmap->clear();
+  }
+}
+
+void
+BarWindow::reset() {
+  if constexpr (PRESENT_MODE == present_mode_e::BUFFERED) {
+    _pixmap->clear();
+  } else {
+    _blits.clear();
+  }
+}
+
+/** render
+ * Put everything drawn since the last reset() on screen.
+ */
+void
+BarWindow::render() {
+  _offset_left = _offset_right = 0;
+  present(0, _width);
+}
+
+/** present
+ * Copy the columns [x, x + width) of what was drawn to the window. When
+ * DIRECT, every pixel is written exactly once: the sections are copied in and
+ * only the gaps between them are filled with the background, all in one batch
+ * of requests. As no pixel is ever cleared before its content is drawn there
+ * is nothing to flicker, so the server isn't grabbed, which would stall every
+ * other client.
+ */
+void
+BarWindow::present(int16_t x, uint16_t width) {
+  const int begin = std::max<int>(x, 0);
+  const int end = std::min<int>(x + width, _width);
+  if (begin >= end) {
+    return;
+  }
+
+  if constexpr (PRESENT_MODE == present_mode_e::BUFFERED) {
+    _window.copy_from(*_pixmap, {static_cast<int16_t>(begin), 0},
+                      {static_cast<int16_t>(begin), 0},
+                      static_cast<uint16_t>(end - begin), _height);
+  } else {
+    // the part of a blit within [begin, end)
+    const auto clip = [begin, end](const blit_t& blit) {
+      return std::pair{std::max<int>(blit.x, begin),
+                       std::min<int>(blit.x + blit.width, end)};
+    };
+
+    auto covered = _blits;
+    std::ranges::sort(covered, {}, &blit_t::x);
+
+    int filled = begin;
+    for (const auto& blit : covered) {
+      const auto [from, to] = clip(blit);
+      if (from >= to) {
+        continue;
+      }
+      if (from > filled) {
+        _window.fill_background(static_cast<int16_t>(filled),
+                                static_cast<uint16_t>(from - filled));
+      }
+      filled = std::max(filled, to);
+    }
+    if (filled < end) {
+      _window.fill_background(static_cast<int16_t>(filled),
+                              static_cast<uint16_t>(end - filled));
+    }
+    for (const auto& blit : _blits) {
+      const auto [from, to] = clip(blit);
+      if (from < to) {
+        _window.copy_from(*blit.pixmap,
+                          {static_cast<int16_t>(from - blit.x), 0},
+                          {static_cast<int16_t>(from), 0},
+                          static_cast<uint16_t>(to - from), _height);
+      }
+    }
+  }
+  _ds.flush();
+  Profiler::Instance().painted();
+}
+
+/** draw
+ * Copy the first `width` pixels of `pixmap` to `x`, either into the bar
+ * pixmap right away or into the window when rendering.
+ */
+void
+BarWindow::draw(const DS::pixmap_t& pixmap, int16_t x, uint16_t width) {
+  if (width == 0) {
+    return;
+  }
+  if constexpr (PRESENT_MODE == present_mode_e::BUFFERED) {
+    _pixmap->copy_from(pixmap, {0, 0}, {x, 0}, width, _height);
+  } else {
+    _blits.push_back({.pixmap = &pixmap, .x = x, .width = width});
+  }
+}
+
+/** move_resize
+ * Move the window to `rect`. The drawing pixmap is only recreated when the size
+ * changes.
+ */
+void
+BarWindow::move_resize(rectangle_t rect) {
+  _window.move_resize(rect);
+  _x = rect.x;
+  _y = rect.y;
+  if (rect.width != _width || rect.height != _height) {
+    _width = rect.width;
+    _height = rect.height;
+    if constexpr (PRESENT_MODE == present_mode_e::BUFFERED) {
+      _pixmap = _window.create_pixmap();
+      _pixmap->clear();
+    }
+  }
+  _offset_left = _offset_right = 0;
 }
 
 std::pair<uint16_t, uint16_t>
 BarWindow::update_left(const SectionPixmap& pixmap) {
   if (pixmap.size() + _offset_left <= _width) {
-    _pixmap.copy_from(pixmap.pixmap(), {0, 0},
-                      {static_cast<int16_t>(_offset_left), 0}, pixmap.size(),
-                      _height);
+    draw(pixmap.pixmap(), static_cast<int16_t>(_offset_left), pixmap.size());
     _offset_left += pixmap.size();
     return {0, pixmap.size()};
   }
@@ -34,9 +151,8 @@ BarWindow::update_middle(const SectionPixmap& pixmap) {
   if (largest_offset < half_width) {
     uint16_t middle_offset =
         std::min<uint16_t>(half_width - largest_offset, pixmap.size() / 2);
-    _pixmap.copy_from(pixmap.pixmap(), {0, 0},
-                      {static_cast<int16_t>(half_width - middle_offset), 0},
-                      middle_offset * 2, _height);
+    draw(pixmap.pixmap(), static_cast<int16_t>(half_width - middle_offset),
+         middle_offset * 2);
     return {half_width - middle_offset, half_width + middle_offset};
   }
   return {0, 0};
@@ -44,10 +160,9 @@ BarWindow::update_middle(const SectionPixmap& pixmap) {
 
 std::pair<uint16_t, uint16_t>
 BarWindow::update_right(const SectionPixmap& pixmap) {
-  _pixmap.copy_from(
-      pixmap.pixmap(), {0, 0},
-      {static_cast<int16_t>(_width - _offset_right - pixmap.size()), 0},
-      pixmap.size(), _height);
+  draw(pixmap.pixmap(),
+       static_cast<int16_t>(_width - _offset_right - pixmap.size()),
+       pixmap.size());
   _offset_right += pixmap.size();
   return {_width - _offset_right, _width};
 }
@@ -3,12 +3,23 @@
 #include <array>
 #include <cstddef>  // size_t
 #include <memory>
+#include <optional>
+#include <vector>
 
 #include "bar_color.h"
 #include "config.h"
 #include "pixmap.h"
+#include "profiler.h"
 #include "types.h"
 
+// reasons for a bar not to be seen
+enum hidden_e : uint8_t {
+  HIDDEN_UNMAPPED = 1U << 0U,
+  HIDDEN_OBSCURED = 1U << 1U,    // fully covered by other windows
+  HIDDEN_FULLSCREEN = 1U << 2U,  // under a fullscreen window
+};
+
+
 /** BarWindow
  * An abstraction for a window that is exclusively used for a status bar.
  */
@@ -24,11 +35,15 @@ class BarWindow {
 
   // Resets the underlying pixelmap used for drawing to the window. Has no
   // effect on the window itself.
-  void reset() { _pixmap.clear(); }
+  void reset();
 
-  void render() {
-    _window.copy_from(_pixmap, {0, 0}, {0, 0}, _width, _height);
-    _offset_left = _offset_right = 0;
+  void render();
+  // Put the retained contents of the columns [x, x + width) on screen again.
+  void present(int16_t x, uint16_t width);
+
+  [[nodiscard]] bool visible() const { return _hidden == 0; }
+  void set_hidden(hidden_e reason, bool hidden) {
+    _hidden = hidden ? (_hidden | reason) : (_hidden & ~reason);
   }
 
   std::pair<uint16_t, uint16_t> update_left(const SectionPixmap& pixmap);
@@ -40,14 +55,38 @@ class BarWindow {
   }
 
   [[nodiscard]] auto generate_mod_pixmap() {
-    return SectionPixmap(_window.create_pixmap(), &_colors, _width, _height);
+    return SectionPixmap(&_window, &_colors, _width, _height);
+  }
+
+  // Give a pixmap from generate_mod_pixmap() the current size of the window.
+  void resize_mod_pixmap(SectionPixmap* pixmap) {
+    pixmap->resize(_width, _height);
   }
 
+  void move_resize(rectangle_t rect);
+
+  [[nodiscard]] rectangle_t rect() const {
+    return {.x = _x, .y = _y, .width = _width, .height = _height};
+  }
+  [[nodiscard]] xcb_window_t id() const { return _window.id(); }
+
  private:
+  // a section waiting to be copied into the window by render()
+  struct blit_t {
+    const DS::pixmap_t* pixmap;
+    int16_t x;
+    uint16_t width;
+  };
+
+  void draw(const DS::pixmap_t& pixmap, int16_t x, uint16_t width);
+
   DS& _ds;
   DS::window_t _window;
-  DS::pixmap_t _pixmap;
+  std::optional<DS::pixmap_t> _pixmap;  // only used when BUFFERED
+  std::vector<blit_t> _blits;           // only used when DIRECT
   BarColors _colors;
+  int16_t _x, _y;
   uint16_t _width, _height;
   uint16_t _offset_left{0}, _offset_right{0};
+  uint8_t _hidden{0};  // hidden_e
 };
@@ -1,10 +1,16 @@
 #include "x.h"
 
+#include <sys/ipc.h>
+#include <sys/shm.h>
 #include <xcb/randr.h>
+#include <xcb/render.h>
+#include <xcb/render_util.h>
+#include <xcb/shm.h>
 #include <xcb/xcb.h>
 #include <xcb/xcb_ewmh.h>
 #include <xcb/xcb_xrm.h>
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <unordered_map>
@@ -15,28 +21,22 @@
 #include "config.h"
 #include "types.h"
 
-enum {
-  NET_WM_WINDOW_TYPE,
-  NET_WM_WINDOW_TYPE_DOCK,
-  NET_WM_DESKTOP,
-  NET_WM_STRUT_PARTIAL,
-  NET_WM_STRUT,
-  NET_WM_STATE,
-  NET_WM_STATE_STICKY,
-  NET_WM_STATE_ABOVE,
-};
+// in 4 byte units (64 KiB), plenty for any resource database
+static constexpr uint32_t rdb_max_length = 16 * 1024;
 
-static constexpr size_t atom_names_size = 8;
-static constexpr std::array<const char*, atom_names_size> atom_names{
+// indexed by atom_e
+static constexpr std::array<const char*, atom_count> atom_names{
     "_NET_WM_WINDOW_TYPE",
     "_NET_WM_WINDOW_TYPE_DOCK",
     "_NET_WM_DESKTOP",
     "_NET_WM_STRUT_PARTIAL",
     "_NET_WM_STRUT",
     "_NET_WM_STATE",
-    // Leave those at the end since are batch-set
     "_NET_WM_STATE_STICKY",
     "_NET_WM_STATE_ABOVE",
+    "_NET_CURRENT_DESKTOP",
+    "_NET_ACTIVE_WINDOW",
+    "_NET_CLIENT_LIST",
 };
 
 std::pair<xcb_visualid_t, Visual*>
@@ -53,11 +53,15 @@ X11::get_xlib_visual() {
 
 X11::X11()
     : _display([] {
+      // modules may query the display server from worker threads
+      XInitThreads();
       Display* display;
       if (display = XOpenDisplay(nullptr); display == nullptr) {
         std::cerr << "Couldnt open display\n";
         exit(EXIT_FAILURE);
       }
+      // before anything else uses the display, the font thread included
+      XSetEventQueueOwner(display, XCBOwnsEventQueue);
       return display;
     }())
     , _connection([this] {
@@ -69,29 +73,98 @@ X11::X11()
       }
       return connection;
     }())
-    , _fonts([this]<size_t... I>(std::index_sequence<I...>)->decltype(_fonts) {
-      return {((create_font(FONTS[I])), ...)};
-    }(std::make_index_sequence<FONTS.size()>{})) {
+    , _primary_font(std::async(std::launch::async,
+                               [this] { return create_font(0); })) {
+  // send every request needed for setup before waiting on any reply so that
+  // they all share a single round trip
+  xcb_prefetch_extension_data(_connection, &xcb_randr_id);
+  xcb_prefetch_extension_data(_connection, &xcb_res_id);
+  xcb_prefetch_extension_data(_connection, &xcb_shm_id);
   auto* ewmh_cookie = xcb_ewmh_init_atoms(_connection, &_ewmh);
+  std::array<xcb_intern_atom_cookie_t, atom_count> atom_cookies;
+  std::transform(atom_names.begin(), atom_names.end(), atom_cookies.begin(),
+                 [this](auto name) { return get_atom_by_name(name); });
+  std::optional<xcb_render_query_pict_formats_cookie_t> formats_cookie;
+  if constexpr (RENDER_BACKEND == render_backend_e::GLYPHSET) {
+    formats_cookie = xcb_render_query_pict_formats(_connection);
+  }
+  // the resource database is only collected by the first get_resource(), by
+  // which time its reply has usually arrived
+  const xcb_window_t root =
+      xcb_setup_roots_iterator(xcb_get_setup(_connection)).data->root;
+  _rdb_cookie =
+      xcb_get_property(_connection, False, root, XCB_ATOM_RESOURCE_MANAGER,
+                       XCB_ATOM_STRING, 0, rdb_max_length);
+
   if (xcb_ewmh_init_atoms_replies(&_ewmh, ewmh_cookie, nullptr) == 0) {
     std::cerr << "Couldn't initialize EWMH atoms\n";
     exit(EXIT_FAILURE);
   }
+  std::transform(
+      atom_cookies.begin(), atom_cookies.end(), _atoms.begin(),
+      [this](auto cookie) {
+        std::unique_ptr<xcb_intern_atom_reply_t, decltype(std::free)*> reply{
+            xcb_intern_atom_reply(_connection, cookie, nullptr), std::free};
+        if (!reply) {
+          std::cerr << "error: atom reply failed.\n";
+          exit(EXIT_FAILURE);
+        }
+        return reply->atom;
+      });
 
-  XSetEventQueueOwner(_display, XCBOwnsEventQueue);
+  _randr = xcb_get_extension_data(_connection, &xcb_randr_id);
+  if (_randr != nullptr && _randr->present) {
+    // monitors were added in RandR 1.5
+    auto cookie = xcb_randr_query_version(_connection, 1, 5);
+    std::unique_ptr<xcb_randr_query_version_reply_t, decltype(std::free)*>
+        version{xcb_randr_query_version_reply(_connection, cookie, nullptr),
+                std::free};
+    if (!version || (version->major_version == 1 && version->minor_version < 5)) {
+      _randr = nullptr;
+    }
+  }
+
+  _res = xcb_get_extension_data(_connection, &xcb_res_id);
+  _shm = xcb_get_extension_data(_connection, &xcb_shm_id);
 
   _screen = xcb_setup_roots_iterator(xcb_get_setup(_connection)).data;
   std::tie(_xlib_visual, _xlib_visual_ptr) = get_xlib_visual();
   _colormap = xcb_generate_id(_connection);
   xcb_create_colormap(_connection, XCB_COLORMAP_ALLOC_NONE, _colormap,
                       _screen->root, _xlib_visual);
-  _gc_bg = generate_id();
+
+  if (formats_cookie) {
+    std::unique_ptr<xcb_render_query_pict_formats_reply_t,
+                    decltype(std::free)*>
+        formats{xcb_render_query_pict_formats_reply(_connection,
+                                                    *formats_cookie, nullptr),
+                std::free};
+    if (!formats) {
+      std::cerr << "error: RENDER picture formats reply failed.\n";
+      exit(EXIT_FAILURE);
+    }
+    if (const auto* a8 = xcb_render_util_find_standard_format(
+            formats.get(), XCB_PICT_STANDARD_A_8)) {
+      _a8_format = a8->id;
+    }
+    if (const auto* visual =
+            xcb_render_util_find_visual_format(formats.get(), _xlib_visual)) {
+      _visual_format = visual->format;
+    }
+  }
 }
 
 X11::~X11() {
-  if (_gc_bg > 1) {
-    xcb_free_gc(_connection, _gc_bg);
+  if (_primary_font.valid()) {
+    _primary_font.wait();
   }
+  _primary_font = {};
+  _fonts = {};
+  if (!_rdb) {
+    xcb_discard_reply(_connection, _rdb_cookie.sequence);
+  }
+  _rdb.reset();
+
   xcb_ewmh_connection_wipe(&_ewmh);
   if (_connection != nullptr) {
     xcb_disconnect(_connection);
@@ -122,9 +195,16 @@ X11::switch_desktop(size_t desktop) {
   xcb_flush(_connection);
 }
 
-X11::font_color_t
+std::shared_ptr<X11::font_color_t>
 X11::create_font_color(const rgba_t& rgb) {
-  return font_color_t(this, rgb);
+  return _font_colors.get(*rgb.val(), [this, &rgb] {
+    return std::shared_ptr<font_color_t>(new font_color_t(this, rgb));
+  });
+}
+
+X11::image_t
+X11::create_image(uint16_t width, uint16_t height) {
+  return image_t(this, width, height);
 }
 
 // TODO: refactor into multiple functions
@@ -138,6 +218,8 @@ X11::create_window(rectangle_t dim, const rgba_t& rgb, bool reserve_space) {
                               XCB_CW_COLORMAP;
   const std::array<uint32_t, 5> value_list{*rgb.val(), *rgb.val(), FORCE_DOCK,
                                            XCB_EVENT_MASK_EXPOSURE |
+                                               XCB_EVENT_MASK_VISIBILITY_CHANGE |
+                                               XCB_EVENT_MASK_STRUCTURE_NOTIFY |
                                                XCB_EVENT_MASK_BUTTON_PRESS |
                                                XCB_EVENT_MASK_FOCUS_CHANGE,
                                            _colormap};
@@ -145,53 +227,28 @@ X11::create_window(rectangle_t dim, const rgba_t& rgb, bool reserve_space) {
   xcb_create_window(_connection, get_depth(), win._id, _screen->root, x, y,
                     width, height, border_width, XCB_WINDOW_CLASS_INPUT_OUTPUT,
                     _xlib_visual, value_mask, value_list.data());
+  win._gc = get_gc(win._id, rgb);
 
   if (!reserve_space) {
     return win;
   }
 
-  std::array<xcb_atom_t, atom_names_size> atom_list;
-  std::transform(
-      atom_names.begin(), atom_names.end(), atom_list.begin(),
-      [this](auto name) {
-        auto* reply =
-            xcb_intern_atom_reply(_connection, get_atom_by_name(name), nullptr);
-        if (!reply) {
-          std::cerr << "error: atom reply failed.\n";
-          exit(EXIT_FAILURE);
-        }
-        return (std::unique_ptr<xcb_intern_atom_reply_t, decltype(std::free)*>{
-                    reply, std::free})
-            ->atom;
-      });
+  win._reserve_space = true;
+  set_strut(win._id, dim);
 
-  std::array<int, 12> strut = {0};
-  // TODO: Find a better way of determining if this is a top-bar
-  if (y == 0) {
-    strut[2] = height;
-    strut[8] = x;
-    strut[9] = x + width;
-  } else {
-    strut[3] = height;
-    strut[10] = x;
-    strut[11] = x + width;
-  }
+  const xcb_atom_t dock = atom(atom_e::NET_WM_WINDOW_TYPE_DOCK);
+  const std::array<xcb_atom_t, 2> state{atom(atom_e::NET_WM_STATE_STICKY),
+                                        atom(atom_e::NET_WM_STATE_ABOVE)};
 
   xcb_change_property(_connection, XCB_PROP_MODE_REPLACE, win._id,
-                      atom_list[NET_WM_WINDOW_TYPE], XCB_ATOM_ATOM, 32, 1,
-                      &atom_list[NET_WM_WINDOW_TYPE_DOCK]);
+                      atom(atom_e::NET_WM_WINDOW_TYPE), XCB_ATOM_ATOM, 32, 1,
+                      &dock);
   xcb_change_property(_connection, XCB_PROP_MODE_APPEND, win._id,
-                      atom_list[NET_WM_STATE], XCB_ATOM_ATOM, 32, 2,
-                      &atom_list[NET_WM_STATE_STICKY]);
+                      atom(atom_e::NET_WM_STATE), XCB_ATOM_ATOM, 32,
+                      state.size(), state.data());
   xcb_change_property(_connection, XCB_PROP_MODE_REPLACE, win._id,
-                      atom_list[NET_WM_DESKTOP], XCB_ATOM_CARDINAL, 32, 1,
+                      atom(atom_e::NET_WM_DESKTOP), XCB_ATOM_CARDINAL, 32, 1,
                       (std::array<uint32_t, 1>{0u - 1u}).data());
-  xcb_change_property(_connection, XCB_PROP_MODE_REPLACE, win._id,
-                      atom_list[NET_WM_STRUT_PARTIAL], XCB_ATOM_CARDINAL, 32,
-                      12, strut.data());
-  xcb_change_property(_connection, XCB_PROP_MODE_REPLACE, win._id,
-                      atom_list[NET_WM_STRUT], XCB_ATOM_CARDINAL, 32, 4,
-                      strut.data());
   xcb_change_property(_connection, XCB_PROP_MODE_REPLACE, win._id,
                       XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, 3, "bar");
   xcb_change_property(_connection, XCB_PROP_MODE_REPLACE, win._id,
@@ -227,12 +284,69 @@ X11::create_window(rectangle_t dim, const rgba_t& rgb, bool reserve_space) {
                         wm_class.data());
   }
 
+  // map the window with its background right away, even if the first paint
+  // is still waiting on modules
+  xcb_flush(_connection);
+
   return win;
 }
 
-X11::rdb_t
-X11::create_resource_database() {
-  return rdb_t(this);
+/** set_strut
+ * Reserve the space of the bar at `dim` on the screen edge it is closest to.
+ */
+void
+X11::set_strut(xcb_window_t window, rectangle_t dim) {
+  const auto [x, y, width, height] = dim;
+  std::array<int, 12> strut = {0};
+  // TODO: Find a better way of determining if this is a top-bar
+  if (y == 0) {
+    strut[2] = height;
+    strut[8] = x;
+    strut[9] = x + width;
+  } else {
+    strut[3] = height;
+    strut[10] = x;
+    strut[11] = x + width;
+  }
+
+  xcb_change_property(_connection, XCB_PROP_MODE_REPLACE, window,
+                      atom(atom_e::NET_WM_STRUT_PARTIAL), XCB_ATOM_CARDINAL,
+                      32, 12, strut.data());
+  xcb_change_property(_connection, XCB_PROP_MODE_REPLACE, window,
+                      atom(atom_e::NET_WM_STRUT), XCB_ATOM_CARDINAL, 32, 4,
+                      strut.data());
+}
+
+/** get_gc
+ * A graphics context with `rgb` as its foreground. Any drawable with the depth
+ * of our windows can be used with it.
+ */
+X11::gc_t
+X11::get_gc(xcb_drawable_t drawable, const rgba_t& rgb) {
+  return _gcs.get(*rgb.val(), [this, drawable, &rgb] {
+    xcb_gcontext_t gc = generate_id();
+    xcb_create_gc(_connection, gc, drawable, XCB_GC_FOREGROUND, rgb.val());
+    return gc_t(new xcb_gcontext_t(gc), [this](const xcb_gcontext_t* gc) {
+      xcb_free_gc(_connection, *gc);
+      delete gc;
+    });
+  });
+}
+
+/** get_resource
+ * Look up an X resource. The resource database is only loaded once, from the
+ * RESOURCE_MANAGER property requested when connecting, and every lookup is
+ * remembered, so bars asking for the same resource don't repeat it.
+ */
+const std::string&
+X11::get_resource(const char* name) {
+  if (auto itr = _resources.find(name); itr != _resources.end()) {
+    return itr->second;
+  }
+  if (!_rdb) {
+    _rdb = std::make_unique<rdb_t>(this, _rdb_cookie);
+  }
+  return _resources.emplace(name, _rdb->get<std::string>(name)).first->second;
 }
 
 
@@ -246,6 +360,78 @@ X11::poll_for_event() {
   return {xcb_poll_for_event(_connection), std::free};
 }
 
+/** watch_monitors
+ * Subscribe to RandR notifications about monitors being added, removed or
+ * reconfigured. See is_monitor_change().
+ */
+void
+X11::watch_monitors() {
+  if (_randr == nullptr || !_randr->present) {
+    return;
+  }
+  xcb_randr_select_input(_connection, _screen->root,
+                         XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE |
+                             XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE |
+                             XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE);
+  xcb_flush(_connection);
+}
+
+bool
+X11::is_monitor_change(const xcb_generic_event_t& event) const {
+  if (_randr == nullptr || !_randr->present) {
+    return false;
+  }
+  const uint8_t type = event.response_type & 0x7F;
+  return type == _randr->first_event + XCB_RANDR_SCREEN_CHANGE_NOTIFY ||
+         type == _randr->first_event + XCB_RANDR_NOTIFY;
+}
+
+/** watch_window_state
+ * Subscribe to changes of the active window and of the state of the window
+ * which is active right now. Has to be called again whenever the active window
+ * changes; the window which was active before is unsubscribed from, so that
+ * its state changes no longer reach the bar. See is_window_state_change().
+ */
+void
+X11::watch_window_state() {
+  const uint32_t values = XCB_EVENT_MASK_PROPERTY_CHANGE;
+  xcb_change_window_attributes(_connection, _screen->root, XCB_CW_EVENT_MASK,
+                               &values);
+  const xcb_window_t active = get_active_window();
+  if (active != _state_window) {
+    if (_state_window != XCB_NONE) {
+      // it may be gone already, which makes this fail harmlessly
+      const uint32_t none = XCB_EVENT_MASK_NO_EVENT;
+      xcb_change_window_attributes(_connection, _state_window,
+                                   XCB_CW_EVENT_MASK, &none);
+    }
+    if (active != XCB_NONE) {
+      xcb_change_window_attributes(_connection, active, XCB_CW_EVENT_MASK,
+                                   &values);
+    }
+    _state_window = active;
+  }
+  xcb_flush(_connection);
+}
+
+/** is_window_state_change
+ * Whether `event` changed which window is active or the state of the active
+ * window.
+ */
+bool
+X11::is_window_state_change(const xcb_generic_event_t& event) const {
+  if ((event.response_type & 0x7F) != XCB_PROPERTY_NOTIFY) {
+    return false;
+  }
+  const auto& property =
+      reinterpret_cast<const xcb_property_notify_event_t&>(event);
+  if (property.atom == atom(atom_e::NET_ACTIVE_WINDOW)) {
+    return property.window == _screen->root;
+  }
+  return property.atom == atom(atom_e::NET_WM_STATE) &&
+         property.window == _state_window && _state_window != XCB_NONE;
+}
+
 xcb_intern_atom_cookie_t
 X11::get_atom_by_name(const char* name) {
   return xcb_intern_atom(_connection, 0, static_cast<uint16_t>(strlen(name)),
@@ -255,35 +441,17 @@ X11::get_atom_by_name(const char* name) {
 
 cppcoro::generator<xcb_window_t>
 X11::get_windows() {
-  xcb_ewmh_get_windows_reply_t clients{};
-  xcb_get_property_cookie_t cookie = xcb_ewmh_get_client_list(&_ewmh, 0);
-  xcb_ewmh_get_client_list_reply(&_ewmh, cookie, &clients, nullptr);
-  for (uint32_t i = 0; i < clients.windows_len; ++i) {
-    co_yield clients.windows[i];
-  }
+  return ::get_windows(&_ewmh);
 }
 
 xcb_window_t
 X11::get_active_window() {
-  // TODO: error checking
-  xcb_window_t active_window = 0;
-  xcb_get_property_cookie_t cookie = xcb_ewmh_get_active_window(&_ewmh, 0);
-  xcb_ewmh_get_active_window_reply(&_ewmh, cookie, &active_window, nullptr);
-  return active_window;
+  return ::get_active_window(&_ewmh);
 }
 
 std::string
 X11::get_window_title(xcb_window_t win) {
-  // TODO: error checking
-  constexpr uint32_t length = 32;  // length * 4 = amount of bytes returned
-  auto cookie = xcb_get_property(_connection, False, win, XCB_ATOM_WM_CLASS,
-                                 XCB_ATOM_STRING, 0, length);
-  std::unique_ptr<xcb_get_property_reply_t, decltype(std::free)*> reply{
-      xcb_get_property_reply(_connection, cookie, nullptr), std::free};
-  char* c_str = static_cast<char*>(xcb_get_property_value(reply.get()));
-
-  // XCB_ATOM_WM_CLASS returns two names where the second is more useful
-  return {c_str + strlen(c_str) + 1 /* NULL byte */};
+  return ::get_window_title(&_ewmh, win);
 }
 
 cppcoro::generator<std::string>
@@ -300,44 +468,166 @@ X11::get_workspace_names() {
 
 uint32_t
 X11::get_current_workspace() {
-  // TODO: error checking
-  uint32_t current_desktop = 0;
-  xcb_get_property_cookie_t cookie = xcb_ewmh_get_current_desktop(&_ewmh, 0);
-  xcb_ewmh_get_current_desktop_reply(&_ewmh, cookie, &current_desktop, nullptr);
-  return current_desktop;
+  return ::get_current_workspace(&_ewmh);
 }
 
 std::optional<uint32_t>
 X11::get_workspace_of_window(xcb_window_t window) {
-  // TODO: error checking
-  uint32_t desktop = 0;
-  xcb_get_property_cookie_t cookie = xcb_ewmh_get_wm_desktop(&_ewmh, window);
-  xcb_ewmh_get_wm_desktop_reply(&_ewmh, cookie, &desktop, nullptr);
-  return desktop;
+  return ::get_workspace_of_window(&_ewmh, window);
+}
+
+bool
+X11::is_window_urgent(xcb_window_t window) {
+  return ::is_window_urgent(&_ewmh, window);
+}
+
+
+/** create_font
+ * Open FONTS[index].
+ */
+std::unique_ptr<X11::font_t>
+X11::create_font(size_t index, int offset) {
+  return std::unique_ptr<font_t>(
+      new font_t(_display, &_font_cache, index, offset));
+}
+
+/** get_fullscreen_area
+ * The area covered by the active window if it is fullscreen.
+ */
+std::optional<rectangle_t>
+X11::get_fullscreen_area() {
+  const xcb_window_t active = get_active_window();
+  if (active == XCB_NONE) {
+    return std::nullopt;
+  }
+
+  auto state_cookie = xcb_ewmh_get_wm_state(&_ewmh, active);
+  auto geometry_cookie = xcb_get_geometry(_connection, active);
+  auto position_cookie =
+      xcb_translate_coordinates(_connection, active, _screen->root, 0, 0);
+
+  bool fullscreen = false;
+  xcb_ewmh_get_atoms_reply_t state;
+  if (xcb_ewmh_get_wm_state_reply(&_ewmh, state_cookie, &state, nullptr) != 0) {
+    fullscreen = std::find(state.atoms, state.atoms + state.atoms_len,
+                           _ewmh._NET_WM_STATE_FULLSCREEN) !=
+                 state.atoms + state.atoms_len;
+    xcb_ewmh_get_atoms_reply_wipe(&state);
+  }
+  std::unique_ptr<xcb_get_geometry_reply_t, decltype(std::free)*> geometry{
+      xcb_get_geometry_reply(_connection, geometry_cookie, nullptr), std::free};
+  std::unique_ptr<xcb_translate_coordinates_reply_t, decltype(std::free)*>
+      position{xcb_translate_coordinates_reply(_connection, position_cookie,
+                                               nullptr),
+               std::free};
+
+  if (!fullscreen || !geometry || !position) {
+    return std::nullopt;
+  }
+  return rectangle_t{.x = position->dst_x,
+                     .y = position->dst_y,
+                     .width = geometry->width,
+                     .height = geometry->height};
+}
+
+/** get_monitors
+ * The area of every active monitor, or of the whole screen if RandR can't tell.
+ */
+std::vector<rectangle_t>
+X11::get_monitors() {
+  std::vector<rectangle_t> monitors;
+  if (_randr != nullptr && _randr->present) {
+    auto cookie = xcb_randr_get_monitors(_connection, _screen->root, 1);
+    std::unique_ptr<xcb_randr_get_monitors_reply_t, decltype(std::free)*> reply{
+        xcb_randr_get_monitors_reply(_connection, cookie, nullptr), std::free};
+    if (reply) {
+      for (auto itr = xcb_randr_get_monitors_monitors_iterator(reply.get());
+           itr.rem > 0; xcb_randr_monitor_info_next(&itr)) {
+        monitors.push_back({.x = itr.data->x,
+                            .y = itr.data->y,
+                            .width = itr.data->width,
+                            .height = itr.data->height});
+      }
+    }
+  }
+
+  if (monitors.empty()) {
+    monitors.push_back({.x = 0,
+                        .y = 0,
+                        .width = _screen->width_in_pixels,
+                        .height = _screen->height_in_pixels});
+  }
+  return monitors;
 }
 
 
-X11::font_t
-X11::create_font(const char* pattern, int offset) {
-  return font_t(_display, pattern, offset);
+/** get_pixmap_bytes
+ * The memory used by all of our pixmaps in the server, as reported by the
+ * X-Resource extension. This costs a round trip.
+ */
+std::optional<uint64_t>
+X11::get_pixmap_bytes() {
+  if (_res == nullptr || !_res->present) {
+    return std::nullopt;
+  }
+
+  const auto client = xcb_get_setup(_connection)->resource_id_base;
+  auto cookie = xcb_res_query_client_pixmap_bytes(_connection, client);
+  std::unique_ptr<xcb_res_query_client_pixmap_bytes_reply_t,
+                  decltype(std::free)*>
+      reply{xcb_res_query_client_pixmap_bytes_reply(_connection, cookie,
+                                                    nullptr),
+            std::free};
+  if (!reply) {
+    return std::nullopt;
+  }
+  return (static_cast<uint64_t>(reply->bytes_overflow) << 32) | reply->bytes;
 }
 
+
 X11::font_t*
 X11::get_drawable_font(uint16_t ch) {
   auto itr = _chars.find(ch);
   return (itr == _chars.end() ? add_char(ch) : itr)->second;
 }
 
+/** get_font
+ * The i'th font of FONTS, opening it first if this is its first use.
+ */
+auto
+X11::get_font(size_t i) -> font_t& {
+  // the primary font is joined first so that only this thread touches the
+  // font cache from here on
+  if (_primary_font.valid()) {
+    _fonts[0] = _primary_font.get();
+  }
+  if (!_fonts[i]) {
+    _fonts[i] = create_font(i);
+  }
+  return *_fonts[i];
+}
+
+/** add_char
+ * Find the first font in FONTS which can draw `ch`, trusting the font cache
+ * for that choice once the font it names has been validated by opening it.
+ */
 auto
 X11::add_char(uint16_t ch) -> decltype(_chars)::iterator {
   font_t& font = [ch, this]() -> font_t& {
-    for (auto& ft : _fonts) {
-      if (ft.has_glyph(ch)) {
+    if (auto cached = _font_cache.font_of(ch)) {
+      font_t& ft = get_font(*cached);
+      if (_font_cache.font_of(ch) == cached) {
+        return ft;
+      }
+    }
+    for (size_t i = 0; i < _fonts.size(); ++i) {
+      if (font_t& ft = get_font(i); ft.has_glyph(ch)) {
+        _font_cache.set_font_of(ch, i);
         return ft;
       }
     }
     std::cerr << "error: character " << ch << " could not be found.\n";
-    return _fonts[0];  // TODO: print error and exit?
+    return get_font(0);  // TODO: print error and exit?
   }();
   return _chars.emplace(std::make_pair(ch, &font)).first;
 }
@@ -356,14 +646,77 @@ FontColor::FontColor(X11* x, const rgba_t& rgb)
 }
 
 FontColor::~FontColor() {
+  if (_solid_fill != 0) {
+    xcb_render_free_picture(_x->_connection, _solid_fill);
+  }
   XftColorFree(_x->_display, _x->_xlib_visual_ptr, _x->_colormap, &_color);
 }
 
+xcb_render_picture_t
+FontColor::solid_fill() {
+  if (_solid_fill == 0) {
+    _solid_fill = _x->generate_id();
+    const xcb_render_color_t color{_color.color.red, _color.color.green,
+                                   _color.color.blue, _color.color.alpha};
+    xcb_render_create_solid_fill(_x->_connection, _solid_fill, color);
+  }
+  return _solid_fill;
+}
 
-FontType::FontType(Display* dpy, const char* pattern, int offset)
-    : _display(dpy), _xft_ft(XftFontOpenName(_display, 0, pattern)) {
+uint32_t
+FontColor::argb() const {
+  const uint32_t alpha = _color.color.alpha >> 8;
+  const auto channel = [alpha](unsigned short value) -> uint32_t {
+    return ((value >> 8) * alpha + 127) / 255;
+  };
+  return alpha << 24 | channel(_color.color.red) << 16 |
+         channel(_color.color.green) << 8 | channel(_color.color.blue);
+}
+
+
+/** open_font
+ * Open FONTS[index]. If the cache knows what the pattern resolved to the last
+ * time it is opened directly, skipping fontconfig's matching.
+ */
+static XftFont*
+open_font(Display* dpy, FontCache* cache, size_t index) {
+  if (auto resolved = cache->resolved(index)) {
+    // the cached string is null terminated
+    FcPattern* pattern =
+        FcNameParse(reinterpret_cast<const FcChar8*>(resolved->data()));
+    if (pattern != nullptr) {
+      if (XftFont* font = XftFontOpenPattern(dpy, pattern); font != nullptr) {
+        return font;  // the font took ownership of the pattern
+      }
+      FcPatternDestroy(pattern);
+    }
+  }
+
+  XftFont* font = XftFontOpenName(dpy, 0, FONTS[index]);
+  FcChar8* file = nullptr;
+  if (font != nullptr &&
+      FcPatternGetString(font->pattern, FC_FILE, 0, &file) == FcResultMatch) {
+    // the charset and languages are large and are recomputed from the face
+    FcPattern* pattern = FcPatternDuplicate(font->pattern);
+    FcPatternDel(pattern, FC_CHARSET);
+    FcPatternDel(pattern, FC_LANG);
+    FcChar8* unparsed = FcNameUnparse(pattern);
+    cache->store(index,
+                 unparsed != nullptr ? reinterpret_cast<char*>(unparsed) : "",
+                 reinterpret_cast<const char*>(file));
+    free(unparsed);
+    FcPatternDestroy(pattern);
+  }
+  return font;
+}
+
+FontType::FontType(Display* dpy, FontCache* cache, size_t index, int offset)
+    : _display(dpy)
+    , _cache(cache)
+    , _index(index)
+    , _xft_ft(open_font(dpy, cache, index)) {
   if (_xft_ft == nullptr) {
-    std::cerr << "Could not load font " << pattern << "\n";
+    std::cerr << "Could not load font " << FONTS[index] << "\n";
     exit(EXIT_FAILURE);
   }
 
@@ -373,6 +726,9 @@ FontType::FontType(Display* dpy, const char* pattern, int offset)
 }
 
 FontType::~FontType() {
+  if (_glyphset != 0) {
+    xcb_render_free_glyph_set(XGetXCBConnection(_display), _glyphset);
+  }
   for (auto& [ch, glyph] : _glyph_map) {
     XftFontUnloadGlyphs(_display, _xft_ft, &glyph.id, 1);
   }
@@ -382,9 +738,20 @@ FontType::~FontType() {
 void
 FontType::draw_ucs2(XftDraw* draw, FontColor* color, const ucs2& str,
                     uint16_t height, size_t x) {
-  const int y = static_cast<int>(height) / 2 + _height / 2 - _descent + _offset;
-  XftDrawString16(draw, color->get(), _xft_ft, static_cast<int>(x), y,
-                  str.data(), static_cast<int>(str.size()));
+  XftDrawString16(draw, color->get(), _xft_ft, static_cast<int>(x),
+                  baseline(height), str.data(), static_cast<int>(str.size()));
+}
+
+void
+FontType::draw_ucs2(raster_t raster, const FontColor* color, const ucs2& str,
+                    uint16_t height, size_t x) {
+  const int y = baseline(height);
+  const uint32_t argb = color->argb();
+  auto pen = static_cast<int>(x);
+  for (uint16_t ch : str) {
+    blend_glyph(raster, get_bitmap(ch), pen, y, argb);
+    pen += char_width(ch);
+  }
 }
 
 auto
@@ -405,7 +772,12 @@ FontType::has_glyph(uint16_t ch) {
 
 uint16_t
 FontType::char_width(uint16_t ch) {
-  return static_cast<uint16_t>(get_glyph(ch)->second.info.xOff);
+  if (auto advance = _cache->advance(_index, ch)) {
+    return *advance;
+  }
+  const auto advance = static_cast<uint16_t>(get_glyph(ch)->second.info.xOff);
+  _cache->set_advance(_index, ch, advance);
+  return advance;
 }
 
 size_t
@@ -415,6 +787,96 @@ FontType::string_size(const ucs2& str) {
       [this](size_t size, uint16_t ch) { return size + char_width(ch); });
 }
 
+/** get_bitmap
+ * The coverage of `ch`, rasterized by FreeType the first time it is needed.
+ * Characters missing from the font are blank.
+ */
+const glyph_bitmap_t&
+FontType::get_bitmap(uint16_t ch) {
+  if (auto itr = _bitmaps.find(ch); itr != _bitmaps.end()) {
+    return itr->second;
+  }
+
+  glyph_bitmap_t bitmap;
+  auto glyph = get_glyph(ch);
+  FT_Face face = glyph != _glyph_map.end() ? XftLockFace(_xft_ft) : nullptr;
+  if (face != nullptr) {
+    if (FT_Load_Glyph(face, glyph->second.id, FT_LOAD_RENDER) == 0) {
+      const FT_GlyphSlot slot = face->glyph;
+      const FT_Bitmap& ft_bitmap = slot->bitmap;
+      bitmap.left = static_cast<int16_t>(slot->bitmap_left);
+      bitmap.top = static_cast<int16_t>(slot->bitmap_top);
+      bitmap.width = static_cast<uint16_t>(ft_bitmap.width);
+      bitmap.height = static_cast<uint16_t>(ft_bitmap.rows);
+      bitmap.coverage.resize(size_t{bitmap.width} * bitmap.height);
+
+      for (size_t row = 0; row < bitmap.height; ++row) {
+        const unsigned char* src =
+            ft_bitmap.buffer + static_cast<ptrdiff_t>(row) * ft_bitmap.pitch;
+        uint8_t* dst = bitmap.coverage.data() + row * bitmap.width;
+        for (size_t col = 0; col < bitmap.width; ++col) {
+          // bitmap fonts come with one bit per pixel
+          dst[col] = ft_bitmap.pixel_mode == FT_PIXEL_MODE_MONO
+                         ? ((src[col / 8] >> (7 - col % 8)) & 1) * 255
+                         : src[col];
+        }
+      }
+    }
+    XftUnlockFace(_xft_ft);
+  }
+  return _bitmaps.emplace(ch, std::move(bitmap)).first->second;
+}
+
+/** glyph_id
+ * The index of `ch` in the font, or that of the missing glyph.
+ */
+FT_UInt
+FontType::glyph_id(uint16_t ch) {
+  auto glyph = get_glyph(ch);
+  return glyph != _glyph_map.end() ? glyph->second.id : 0;
+}
+
+/** upload_glyphs
+ * Make sure every glyph of `str` is in the font's glyphset on the server, which
+ * is created on first use. Glyphs are stored under their id in the font.
+ */
+xcb_render_glyphset_t
+FontType::upload_glyphs(xcb_connection_t* conn, xcb_render_pictformat_t format,
+                        const ucs2& str) {
+  if (_glyphset == 0) {
+    _glyphset = xcb_generate_id(conn);
+    xcb_render_create_glyph_set(conn, _glyphset, format);
+  }
+
+  for (uint16_t ch : str) {
+    const FT_UInt id = glyph_id(ch);
+    if (!_uploaded.insert(id).second) {
+      continue;
+    }
+
+    const glyph_bitmap_t& bitmap = get_bitmap(ch);
+    // rows of A8 images are padded to 32 bits
+    const size_t stride = (bitmap.width + 3U) & ~3U;
+    std::vector<uint8_t> data(stride * bitmap.height);
+    for (size_t row = 0; row < bitmap.height; ++row) {
+      std::copy_n(bitmap.coverage.data() + row * bitmap.width, bitmap.width,
+                  data.data() + row * stride);
+    }
+
+    const uint32_t glyph = id;
+    const xcb_render_glyphinfo_t info{
+        .width = bitmap.width,
+        .height = bitmap.height,
+        .x = static_cast<int16_t>(-bitmap.left),
+        .y = bitmap.top,
+        .x_off = static_cast<int16_t>(char_width(ch)),
+        .y_off = 0};
+    xcb_render_add_glyphs(conn, _glyphset, 1, &glyph, &info,
+                          static_cast<uint32_t>(data.size()), data.data());
+  }
+  return _glyphset;
+}
+
 auto
 FontType::create_glyph(uint16_t ch) -> glyph_t {
   XGlyphInfo glyph_info;
@@ -432,8 +894,10 @@ X11::window_t::window_t(X11* x, uint16_t width, uint16_t height)
 X11::window_t::window_t(window_t&& rhs) noexcept
     : _x(std::exchange(rhs._x, nullptr))
     , _id(rhs._id)
+    , _gc(std::move(rhs._gc))
     , _width(rhs._width)
-    , _height(rhs._height) {
+    , _height(rhs._height)
+    , _reserve_space(rhs._reserve_space) {
 }
 
 X11::window_t::~window_t() {
@@ -452,27 +916,52 @@ X11::window_t::configure(uint16_t mask, const void* list) {
   xcb_configure_window(_x->_connection, _id, mask, list);
 }
 
+void
+X11::window_t::move_resize(rectangle_t dim) {
+  const std::array<uint32_t, 4> values{
+      static_cast<uint32_t>(dim.x), static_cast<uint32_t>(dim.y), dim.width,
+      dim.height};
+  configure(XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+                XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+            values.data());
+  _width = dim.width;
+  _height = dim.height;
+  if (_reserve_space) {
+    _x->set_strut(_id, dim);
+  }
+}
+
 void
 X11::window_t::copy_from(const pixmap_t& rhs, coordinate_t src,
                          coordinate_t dst, uint16_t width, uint16_t height) {
-  xcb_copy_area(_x->_connection, rhs._id, _id, _x->_gc_bg, src.x, 0, dst.x, 0,
-                width, height);
+  xcb_copy_area(_x->_connection, rhs._id, _id, *_gc, src.x, 0, dst.x, 0, width,
+                height);
+}
+
+void
+X11::window_t::fill_background(int16_t x, uint16_t width) {
+  xcb_rectangle_t rect = {x, 0, width, _height};
+  xcb_poly_fill_rectangle(_x->_connection, _id, *_gc, 1, &rect);
 }
 
 X11::pixmap_t
 X11::window_t::create_pixmap() const {
-  return pixmap_t(_x, _id, _width, _height);
+  return create_pixmap(_width);
 }
 
-void
-X11::window_t::create_gc(const rgba_t& rgb) const {
-  xcb_create_gc(_x->_connection, _x->_gc_bg, _id, XCB_GC_FOREGROUND, rgb.val());
+X11::pixmap_t
+X11::window_t::create_pixmap(uint16_t width) const {
+  return pixmap_t(_x, _id, _gc, width, _height);
 }
 
 
-X11::pixmap_t::pixmap_t(X11* x, xcb_drawable_t drawable, uint16_t width,
-                        uint16_t height)
-    : _x(x), _id(x->generate_id()), _width(width), _height(height) {
+X11::pixmap_t::pixmap_t(X11* x, xcb_drawable_t drawable, gc_t gc,
+                        uint16_t width, uint16_t height)
+    : _x(x)
+    , _id(x->generate_id())
+    , _gc(std::move(gc))
+    , _width(width)
+    , _height(height) {
   xcb_create_pixmap(_x->_connection, _x->get_depth(), _id, drawable, width,
                     height);
 }
@@ -480,28 +969,45 @@ X11::pixmap_t::pixmap_t(X11* x, xcb_drawable_t drawable, uint16_t width,
 X11::pixmap_t::pixmap_t(pixmap_t&& rhs) noexcept
     : _x(std::exchange(rhs._x, nullptr))
     , _id(rhs._id)
+    , _gc(std::move(rhs._gc))
+    , _picture(std::exchange(rhs._picture, 0))
     , _width(rhs._width)
     , _height(rhs._height) {
 }
 
 
+X11::pixmap_t&
+X11::pixmap_t::operator=(pixmap_t&& rhs) noexcept {
+  std::swap(_x, rhs._x);
+  std::swap(_id, rhs._id);
+  std::swap(_gc, rhs._gc);
+  std::swap(_picture, rhs._picture);
+  std::swap(_width, rhs._width);
+  std::swap(_height, rhs._height);
+  return *this;
+}
+
 X11::pixmap_t::~pixmap_t() {
-  if (_x != nullptr) {
-    xcb_free_pixmap(_x->_connection, _id);
+  if (_x == nullptr) {
+    return;
   }
+  if (_picture != 0) {
+    xcb_render_free_picture(_x->_connection, _picture);
+  }
+  xcb_free_pixmap(_x->_connection, _id);
 }
 
 void
 X11::pixmap_t::clear() {
   xcb_rectangle_t rect = {0, 0, _width, _height};
-  xcb_poly_fill_rectangle(_x->_connection, _id, _x->_gc_bg, 1, &rect);
+  xcb_poly_fill_rectangle(_x->_connection, _id, *_gc, 1, &rect);
 }
 
 void
 X11::pixmap_t::copy_from(const pixmap_t& rhs, coordinate_t src,
                          coordinate_t dst, uint16_t width, uint16_t height) {
-  xcb_copy_area(_x->_connection, rhs._id, _id, _x->_gc_bg, src.x, 0, dst.x, 0,
-                width, height);
+  xcb_copy_area(_x->_connection, rhs._id, _id, *_gc, src.x, 0, dst.x, 0, width,
+                height);
 }
 
 XftDraw*
@@ -509,8 +1015,235 @@ X11::pixmap_t::create_xft_draw() const {
   return XftDrawCreate(_x->_display, _id, _x->_xlib_visual_ptr, _x->_colormap);
 }
 
+xcb_render_picture_t
+X11::pixmap_t::picture() {
+  if (_picture == 0) {
+    _picture = _x->generate_id();
+    xcb_render_create_picture(_x->_connection, _picture, _id,
+                              _x->_visual_format, 0, nullptr);
+  }
+  return _picture;
+}
+
+/** draw_glyphs
+ * Draw `runs` with one CompositeGlyphs16 request per color. Every run is one
+ * or more glyph elements, switching glyphsets in between when the font
+ * changes.
+ */
+void
+X11::pixmap_t::draw_glyphs(const std::vector<glyph_run_t>& runs) {
+  // header of a glyph element, followed by `len` glyph ids. A len of 255
+  // instead switches to the glyphset which follows.
+  struct element_t {
+    uint8_t len;
+    std::array<uint8_t, 3> pad;
+    int16_t dx;
+    int16_t dy;
+  };
+  constexpr size_t max_len = 254;
+
+  auto* conn = _x->_connection;
+  std::vector<const glyph_run_t*> pending;
+  for (const auto& run : runs) {
+    pending.push_back(&run);
+  }
+
+  std::vector<uint8_t> cmds;
+  const auto append = [&cmds](const auto& value) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    cmds.insert(cmds.end(), bytes, bytes + sizeof(value));
+  };
+
+  while (!pending.empty()) {
+    FontColor* color = pending.front()->color;
+    cmds.clear();
+    xcb_render_glyphset_t first = 0;
+    xcb_render_glyphset_t current = 0;
+    int pen_x = 0;
+    int pen_y = 0;
+
+    for (const glyph_run_t* run : pending) {
+      if (run->color != color || run->str.empty()) {
+        continue;
+      }
+
+      auto glyphset =
+          run->font->upload_glyphs(conn, _x->_a8_format, run->str);
+      if (first == 0) {
+        first = current = glyphset;
+      } else if (glyphset != current) {
+        append(element_t{.len = 255, .pad = {}, .dx = 0, .dy = 0});
+        append(glyphset);
+        current = glyphset;
+      }
+
+      const int y = run->font->baseline(_height);
+      int x = run->x;
+      for (size_t i = 0; i < run->str.size(); i += max_len) {
+        const size_t len = std::min(max_len, run->str.size() - i);
+        append(element_t{.len = static_cast<uint8_t>(len),
+                         .pad = {},
+                         .dx = static_cast<int16_t>(x - pen_x),
+                         .dy = static_cast<int16_t>(y - pen_y)});
+        pen_x = x;
+        pen_y = y;
+        for (size_t j = i; j < i + len; ++j) {
+          append(static_cast<uint16_t>(run->font->glyph_id(run->str[j])));
+          pen_x += run->font->char_width(run->str[j]);
+        }
+        cmds.resize((cmds.size() + 3) & ~size_t{3});
+        x = pen_x;
+      }
+    }
+
+    if (!cmds.empty()) {
+      xcb_render_composite_glyphs_16(
+          conn, XCB_RENDER_PICT_OP_OVER, color->solid_fill(), picture(), 0,
+          first, 0, 0, static_cast<uint32_t>(cmds.size()), cmds.data());
+    }
+    std::erase_if(pending,
+                  [color](const glyph_run_t* run) { return run->color == color; });
+  }
+}
+
+
+X11::image_t::image_t(X11* x, uint16_t width, uint16_t height)
+    : _x(x), _width(width), _height(height) {
+  const size_t size = size_t{width} * height;
+  if (_x->_shm != nullptr && _x->_shm->present) {
+    const int id = shmget(IPC_PRIVATE, size * sizeof(uint32_t), IPC_CREAT | 0600);
+    void* addr = id != -1 ? shmat(id, nullptr, 0) : nullptr;
+    if (addr != nullptr && addr != reinterpret_cast<void*>(-1)) {
+      const xcb_shm_seg_t seg = _x->generate_id();
+      auto cookie = xcb_shm_attach_checked(_x->_connection, seg,
+                                           static_cast<uint32_t>(id), 0);
+      if (xcb_generic_error_t* error =
+              xcb_request_check(_x->_connection, cookie)) {
+        // e.g. the server is on another machine, don't try again
+        free(error);
+        shmdt(addr);
+        _x->_shm = nullptr;
+      } else {
+        _seg = seg;
+        _data = static_cast<uint32_t*>(addr);
+      }
+    }
+    if (id != -1) {
+      // the segment is released once both sides detached
+      shmctl(id, IPC_RMID, nullptr);
+    }
+  }
+
+  if (_data == nullptr) {
+    _data = new uint32_t[size]();
+  }
+}
+
+X11::image_t::image_t(image_t&& rhs) noexcept
+    : _x(std::exchange(rhs._x, nullptr))
+    , _width(rhs._width)
+    , _height(rhs._height)
+    , _data(std::exchange(rhs._data, nullptr))
+    , _seg(std::exchange(rhs._seg, 0))
+    , _pending(rhs._pending) {
+}
+
+X11::image_t&
+X11::image_t::operator=(image_t&& rhs) noexcept {
+  std::swap(_x, rhs._x);
+  std::swap(_width, rhs._width);
+  std::swap(_height, rhs._height);
+  std::swap(_data, rhs._data);
+  std::swap(_seg, rhs._seg);
+  std::swap(_pending, rhs._pending);
+  return *this;
+}
+
+X11::image_t::~image_t() {
+  if (_x == nullptr) {
+    return;
+  }
+  if (_seg != 0) {
+    // the server detaches after any upload still in flight
+    xcb_shm_detach(_x->_connection, _seg);
+    shmdt(_data);
+  } else {
+    delete[] _data;
+  }
+}
+
+raster_t
+X11::image_t::raster() {
+  sync();
+  return {.pixels = _data, .stride = _width, .width = _width, .height = _height};
+}
+
+/** put
+ * Upload the first `width` columns of the image into `pixmap`.
+ */
+void
+X11::image_t::put(const pixmap_t& pixmap, uint16_t width) {
+  width = std::min(width, _width);
+  if (width == 0) {
+    return;
+  }
+
+  auto* conn = _x->_connection;
+  const uint8_t depth = _x->get_real_depth();
+  if (_seg != 0) {
+    xcb_shm_put_image(conn, pixmap._id, *pixmap._gc, _width, _height, 0, 0,
+                      width, _height, 0, 0, depth, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                      0, _seg, 0);
+    _pending = true;
+    return;
+  }
+
+  // PutImage sends whole rows, as many per request as the server accepts
+  const size_t row_size = size_t{_width} * sizeof(uint32_t);
+  const size_t max_size = xcb_get_maximum_request_length(conn) * 4 -
+                          sizeof(xcb_put_image_request_t);
+  const auto max_rows = std::max<size_t>(1, max_size / row_size);
+  for (uint16_t y = 0; y < _height;) {
+    const auto rows =
+        static_cast<uint16_t>(std::min<size_t>(max_rows, _height - y));
+    xcb_put_image(conn, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap._id, *pixmap._gc,
+                  _width, rows, 0, static_cast<int16_t>(y), 0, depth,
+                  static_cast<uint32_t>(rows * row_size),
+                  reinterpret_cast<const uint8_t*>(_data + y * _width));
+    y += rows;
+  }
+}
+
+/** sync
+ * The server reads shared memory whenever it gets to a request, so wait for it
+ * to get past the last upload before the image is changed again.
+ */
+void
+X11::image_t::sync() {
+  if (!_pending) {
+    return;
+  }
+  auto* conn = _x->_connection;
+  free(xcb_get_input_focus_reply(conn, xcb_get_input_focus(conn), nullptr));
+  _pending = false;
+}
 
-X11::rdb_t::rdb_t(X11* x) : _db(xcb_xrm_database_from_default(x->_connection)) {
+
+X11::rdb_t::rdb_t(X11* x, xcb_get_property_cookie_t cookie)
+    : _db([x, cookie] {
+      auto* conn = x->_connection;
+      std::unique_ptr<xcb_get_property_reply_t, decltype(std::free)*> reply{
+          xcb_get_property_reply(conn, cookie, nullptr), std::free};
+      if (!reply || xcb_get_property_value_length(reply.get()) <= 0) {
+        // no RESOURCE_MANAGER, xcb-xrm falls back to the resource files
+        return xcb_xrm_database_from_default(conn);
+      }
+      // the property isn't null terminated
+      const std::string resources(
+          static_cast<const char*>(xcb_get_property_value(reply.get())),
+          static_cast<size_t>(xcb_get_property_value_length(reply.get())));
+      return xcb_xrm_database_from_string(resources.c_str());
+    }()) {
 }
 
 X11::rdb_t::~rdb_t() {
@@ -534,15 +1267,6 @@ X11::rdb_t::get<std::string>(const char* query) {
 
 
 // helpers
-xcb_atom_t
-get_atom(xcb_connection_t* conn, const char* name) {
-  auto str_len = static_cast<uint16_t>(strlen(name));
-  auto cookie = xcb_intern_atom(conn, 0, str_len, name);
-  std::unique_ptr<xcb_intern_atom_reply_t, decltype(std::free)*> reply{
-      xcb_intern_atom_reply(conn, cookie, nullptr), std::free};
-  return reply ? reply->atom : XCB_NONE;
-}
-
 xcb_connection_t*
 get_connection() {
   auto* conn = xcb_connect(nullptr, nullptr);
@@ -580,3 +1304,90 @@ get_connection() {
   }
   return conn;
 }
+
+
+// queries on any EWMH connection
+
+cppcoro::generator<xcb_window_t>
+get_windows(xcb_ewmh_connection_t* ewmh) {
+  xcb_ewmh_get_windows_reply_t clients{};
+  xcb_get_property_cookie_t cookie = xcb_ewmh_get_client_list(ewmh, 0);
+  xcb_ewmh_get_client_list_reply(ewmh, cookie, &clients, nullptr);
+  for (uint32_t i = 0; i < clients.windows_len; ++i) {
+    co_yield clients.windows[i];
+  }
+}
+
+xcb_window_t
+get_active_window(xcb_ewmh_connection_t* ewmh) {
+  // TODO: error checking
+  xcb_window_t active_window = 0;
+  xcb_get_property_cookie_t cookie = xcb_ewmh_get_active_window(ewmh, 0);
+  xcb_ewmh_get_active_window_reply(ewmh, cookie, &active_window, nullptr);
+  return active_window;
+}
+
+std::string
+get_window_title(xcb_ewmh_connection_t* ewmh, xcb_window_t win) {
+  // TODO: error checking
+  constexpr uint32_t length = 32;  // length * 4 = amount of bytes returned
+  auto cookie = xcb_get_property(ewmh->connection, False, win,
+                                 XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, length);
+  std::unique_ptr<xcb_get_property_reply_t, decltype(std::free)*> reply{
+      xcb_get_property_reply(ewmh->connection, cookie, nullptr), std::free};
+  char* c_str = static_cast<char*>(xcb_get_property_value(reply.get()));
+
+  // XCB_ATOM_WM_CLASS returns two names where the second is more useful
+  return {c_str + strlen(c_str) + 1 /* NULL byte */};
+}
+
+uint32_t
+get_current_workspace(xcb_ewmh_connection_t* ewmh) {
+  // TODO: error checking
+  uint32_t current_desktop = 0;
+  xcb_get_property_cookie_t cookie = xcb_ewmh_get_current_desktop(ewmh, 0);
+  xcb_ewmh_get_current_desktop_reply(ewmh, cookie, &current_desktop, nullptr);
+  return current_desktop;
+}
+
+std::optional<uint32_t>
+get_workspace_of_window(xcb_ewmh_connection_t* ewmh, xcb_window_t window) {
+  // TODO: error checking
+  uint32_t desktop = 0;
+  xcb_get_property_cookie_t cookie = xcb_ewmh_get_wm_desktop(ewmh, window);
+  xcb_ewmh_get_wm_desktop_reply(ewmh, cookie, &desktop, nullptr);
+  return desktop;
+}
+
+/** is_window_urgent
+ * Whether `window` asks for attention, either with the urgency bit of its
+ * WM_HINTS or with _NET_WM_STATE_DEMANDS_ATTENTION. Both properties are
+ * requested before either reply is waited on.
+ */
+bool
+is_window_urgent(xcb_ewmh_connection_t* ewmh, xcb_window_t window) {
+  constexpr uint32_t urgency_hint = 1U << 8;  // XUrgencyHint
+  // the flags are the first word of WM_HINTS
+  auto hints_cookie =
+      xcb_get_property(ewmh->connection, False, window, XCB_ATOM_WM_HINTS,
+                       XCB_ATOM_WM_HINTS, 0, 1);
+  auto state_cookie = xcb_ewmh_get_wm_state(ewmh, window);
+
+  bool urgent = false;
+  std::unique_ptr<xcb_get_property_reply_t, decltype(std::free)*> hints{
+      xcb_get_property_reply(ewmh->connection, hints_cookie, nullptr),
+      std::free};
+  if (hints && xcb_get_property_value_length(hints.get()) >=
+                   static_cast<int>(sizeof(uint32_t))) {
+    urgent = (*static_cast<uint32_t*>(xcb_get_property_value(hints.get())) &
+              urgency_hint) != 0;
+  }
+  xcb_ewmh_get_atoms_reply_t state;
+  if (xcb_ewmh_get_wm_state_reply(ewmh, state_cookie, &state, nullptr) != 0) {
+    urgent |= std::find(state.atoms, state.atoms + state.atoms_len,
+                        ewmh->_NET_WM_STATE_DEMANDS_ATTENTION) !=
+              state.atoms + state.atoms_len;
+    xcb_ewmh_get_atoms_reply_wipe(&state);
+  }
+  return urgent;
+}
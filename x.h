@@ -4,33 +4,92 @@
 #include <X11/Xlib-xcb.h>
 #include <X11/Xlib.h>
 #include <fontconfig/fontconfig.h>
+#include <xcb/randr.h>
+#include <xcb/render.h>
+#include <xcb/res.h>
+#include <xcb/shm.h>
 #include <xcb/xcb.h>
 #include <xcb/xcb_ewmh.h>
 #include <xcb/xcb_xrm.h>
 #include <xcb/xproto.h>
 
 #include <cppcoro/generator.hpp>
+#include <future>
+#include <memory>
 #include <numeric>
 #include <optional>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "color.h"
 #include "config_font.h"
+#include "font_cache.h"
+#include "raster.h"
 #include "types.h"
 
 class X11;
 
 
+/** atom_e
+ * Every atom limebar uses. They are interned in a single batch when the
+ * display server connection is set up and are looked up with X11::atom().
+ * Atoms are global to the server, so they are valid on any connection.
+ */
+enum class atom_e : uint8_t {
+  NET_WM_WINDOW_TYPE,
+  NET_WM_WINDOW_TYPE_DOCK,
+  NET_WM_DESKTOP,
+  NET_WM_STRUT_PARTIAL,
+  NET_WM_STRUT,
+  NET_WM_STATE,
+  NET_WM_STATE_STICKY,
+  NET_WM_STATE_ABOVE,
+  NET_CURRENT_DESKTOP,
+  NET_ACTIVE_WINDOW,
+  NET_CLIENT_LIST,
+  COUNT,
+};
+
+constexpr size_t atom_count = static_cast<size_t>(atom_e::COUNT);
+
+
+/** interned_t
+ * Hands out shared handles to resources keyed by value, so that equal requests
+ * share one allocation. A resource is released with its last handle.
+ */
+template <typename Key, typename T>
+class interned_t {
+ public:
+  template <typename Create>
+  std::shared_ptr<T> get(const Key& key, Create&& create) {
+    if (auto handle = _resources[key].lock()) {
+      return handle;
+    }
+    std::erase_if(_resources, [](const auto& r) { return r.second.expired(); });
+    std::shared_ptr<T> handle = create();
+    _resources[key] = handle;
+    return handle;
+  }
+
+ private:
+  std::unordered_map<Key, std::weak_ptr<T>> _resources;
+};
+
+
 class FontColor {
  public:
   ~FontColor();
-  FontColor(const FontColor& rhs) = default;
-  FontColor(FontColor&&) = default;
-  FontColor& operator=(const FontColor&) = default;
-  FontColor& operator=(FontColor&&) = default;
+  FontColor(const FontColor& rhs) = delete;
+  FontColor(FontColor&&) = delete;
+  FontColor& operator=(const FontColor&) = delete;
+  FontColor& operator=(FontColor&&) = delete;
 
   XftColor* get() { return &_color; }
+  // the color as a premultiplied 0xAARRGGBB pixel
+  [[nodiscard]] uint32_t argb() const;
+  // a RENDER picture filled with the color
+  xcb_render_picture_t solid_fill();
 
  private:
   friend X11;
@@ -38,6 +97,7 @@ class FontColor {
 
   X11* _x;
   XftColor _color;
+  xcb_render_picture_t _solid_fill{0};
 };
 
 
@@ -58,6 +118,8 @@ class FontType {
 
   void draw_ucs2(XftDraw* draw, FontColor* color, const ucs2& str,
                  uint16_t height, size_t x);
+  void draw_ucs2(raster_t raster, const FontColor* color, const ucs2& str,
+                 uint16_t height, size_t x);
 
   bool has_glyph(uint16_t ch);
   size_t string_size(const ucs2& str);
@@ -70,7 +132,7 @@ class FontType {
 
  private:
   friend X11;
-  FontType(Display* dpy, const char* pattern, int offset = 0);
+  FontType(Display* dpy, FontCache* cache, size_t index, int offset = 0);
 
   using glyph_map_t = std::unordered_map<uint16_t, glyph_t>;
   using glyph_map_itr = glyph_map_t::const_iterator;
@@ -78,14 +140,40 @@ class FontType {
   glyph_map_itr get_glyph(uint16_t ch);
   glyph_t create_glyph(uint16_t ch);
   uint16_t char_width(uint16_t ch);
+  const glyph_bitmap_t& get_bitmap(uint16_t ch);
+  FT_UInt glyph_id(uint16_t ch);
+  xcb_render_glyphset_t upload_glyphs(xcb_connection_t* conn,
+                                      xcb_render_pictformat_t format,
+                                      const ucs2& str);
+  [[nodiscard]] int baseline(uint16_t height) const {
+    return static_cast<int>(height) / 2 + _height / 2 - _descent + _offset;
+  }
 
   int _descent{0};
   int _height{0};
   int _offset{0};
 
   Display* _display;
+  FontCache* _cache;
+  size_t _index;  // into FONTS
   XftFont* _xft_ft;
   glyph_map_t _glyph_map;
+  std::unordered_map<uint16_t, glyph_bitmap_t> _bitmaps;  // rasterized glyphs
+
+  // glyphs uploaded to the server, see upload_glyphs()
+  xcb_render_glyphset_t _glyphset{0};
+  std::unordered_set<FT_UInt> _uploaded;
+};
+
+
+/** glyph_run_t
+ * A string waiting to be drawn by X11::pixmap_t::draw_glyphs().
+ */
+struct glyph_run_t {
+  FontType* font;
+  FontColor* color;
+  int16_t x;
+  ucs2 str;
 };
 
 
@@ -93,8 +181,10 @@ class X11 {
  public:
   using font_color_t = FontColor;
   using font_t = FontType;
+  using gc_t = std::shared_ptr<const xcb_gcontext_t>;
   class window_t;
   class pixmap_t;  // created through window_t
+  class image_t;
   class rdb_t;
 
   static X11& Instance();
@@ -110,17 +200,31 @@ class X11 {
   void activate_window(xcb_window_t window);
   void switch_desktop(size_t desktop);
 
-  // resource creators
-  [[nodiscard]] auto create_font_color(const rgba_t& rgb) -> font_color_t;
-  [[nodiscard]] auto create_font(const char* pattern, int offset = 0) -> font_t;
+  // resource creators. Colors and GCs are shared by everyone asking for the
+  // same value.
+  [[nodiscard]] auto create_font_color(const rgba_t& rgb)
+      -> std::shared_ptr<font_color_t>;
+  [[nodiscard]] auto create_font(size_t index, int offset = 0)
+      -> std::unique_ptr<font_t>;
+  [[nodiscard]] auto create_image(uint16_t width, uint16_t height) -> image_t;
   [[nodiscard]] auto create_window(rectangle_t dim, const rgba_t& rgb,
                                    bool reserve_space) -> window_t;
-  [[nodiscard]] auto create_resource_database() -> rdb_t;
+
+  // Send any buffered requests to the server.
+  void flush() { xcb_flush(_connection); }
+
+  // the connection, for EventLoop::wake_on()
+  [[nodiscard]] int fd() const { return xcb_get_file_descriptor(_connection); }
 
   // events
   // TODO: abstract this away from xcb_* details
   std::unique_ptr<xcb_generic_event_t, decltype(std::free)*> wait_for_event();
   std::unique_ptr<xcb_generic_event_t, decltype(std::free)*> poll_for_event();
+  void watch_monitors();
+  [[nodiscard]] bool is_monitor_change(const xcb_generic_event_t& event) const;
+  void watch_window_state();
+  [[nodiscard]] bool is_window_state_change(
+      const xcb_generic_event_t& event) const;
 
   // queries
   [[nodiscard]] auto get_windows() -> cppcoro::generator<xcb_window_t>;
@@ -130,10 +234,20 @@ class X11 {
   [[nodiscard]] auto get_current_workspace() -> uint32_t;
   [[nodiscard]] auto get_workspace_of_window(xcb_window_t window)
       -> std::optional<uint32_t>;
+  [[nodiscard]] bool is_window_urgent(xcb_window_t window);
+  [[nodiscard]] auto get_monitors() -> std::vector<rectangle_t>;
+  [[nodiscard]] auto get_fullscreen_area() -> std::optional<rectangle_t>;
+  [[nodiscard]] auto get_resource(const char* name) -> const std::string&;
+  [[nodiscard]] auto get_pixmap_bytes() -> std::optional<uint64_t>;
 
   // fonts
   [[nodiscard]] auto get_drawable_font(uint16_t ch) -> font_t*;
 
+  // atoms
+  [[nodiscard]] xcb_atom_t atom(atom_e a) const {
+    return _atoms[static_cast<size_t>(a)];
+  }
+
  private:
   friend font_color_t;
   friend font_t;
@@ -143,25 +257,52 @@ class X11 {
   uint8_t get_depth() {
     return (_xlib_visual == _screen->root_visual) ? XCB_COPY_FROM_PARENT : 32;
   }
+  uint8_t get_real_depth() {
+    return (_xlib_visual == _screen->root_visual) ? _screen->root_depth : 32;
+  }
   auto get_xlib_visual() -> std::pair<xcb_visualid_t, Visual*>;
   auto get_atom_by_name(const char* name) -> xcb_intern_atom_cookie_t;
   uint32_t generate_id() { return xcb_generate_id(_connection); }
+  void set_strut(xcb_window_t window, rectangle_t dim);
+  auto get_gc(xcb_drawable_t drawable, const rgba_t& rgb) -> gc_t;
 
   Display* _display;
   xcb_connection_t* _connection;
   xcb_ewmh_connection_t _ewmh;
   xcb_screen_t* _screen;
+  std::array<xcb_atom_t, atom_count> _atoms;
+  const xcb_query_extension_reply_t* _randr;
+  const xcb_query_extension_reply_t* _res;
+  const xcb_query_extension_reply_t* _shm;
+  xcb_render_pictformat_t _a8_format{0};
+  xcb_render_pictformat_t _visual_format{0};
 
-  xcb_gcontext_t _gc_bg;
   xcb_colormap_t _colormap;
+  // the active window whose state is watched, see watch_window_state()
+  xcb_window_t _state_window{XCB_NONE};
+
+  // resources shared between bars, keyed by pixel value
+  interned_t<uint32_t, font_color_t> _font_colors;
+  interned_t<uint32_t, const xcb_gcontext_t> _gcs;
+
+  // X resources are requested when connecting and read once, the first time
+  // one is needed
+  xcb_get_property_cookie_t _rdb_cookie;
+  std::unique_ptr<rdb_t> _rdb;
+  std::unordered_map<std::string, std::string> _resources;
 
   Visual* _xlib_visual_ptr;
   xcb_visualid_t _xlib_visual;
 
-  // fonts
-  std::array<font_t, FONTS.size()> _fonts;
+  // fonts. The primary font is opened in the background while the rest of the
+  // connection is set up, fallback fonts are only opened once a character is
+  // missing from every font before them.
+  FontCache _font_cache;
+  std::future<std::unique_ptr<font_t>> _primary_font;
+  std::array<std::unique_ptr<font_t>, FONTS.size()> _fonts;
   std::unordered_map<uint16_t, font_t*> _chars;
 
+  auto get_font(size_t i) -> font_t&;
   decltype(_chars)::iterator add_char(uint16_t ch);
 };
 
@@ -176,12 +317,16 @@ class X11::window_t {
 
   void make_visible();
   void configure(uint16_t mask, const void* list);
+  void move_resize(rectangle_t dim);
+
+  [[nodiscard]] xcb_window_t id() const { return _id; }
 
   void copy_from(const pixmap_t& rhs, coordinate_t src, coordinate_t dst,
                  uint16_t width, uint16_t height);
+  void fill_background(int16_t x, uint16_t width);
 
   pixmap_t create_pixmap() const;
-  void create_gc(const rgba_t& rgb) const;
+  pixmap_t create_pixmap(uint16_t width) const;
 
  private:
   friend X11;  // TODO temporary
@@ -189,8 +334,10 @@ class X11::window_t {
 
   X11* _x;
   xcb_window_t _id;
+  gc_t _gc;  // filled with the background color
   uint16_t _width;
   uint16_t _height;
+  bool _reserve_space{false};
 };
 
 
@@ -200,27 +347,71 @@ class X11::pixmap_t {
   pixmap_t(const pixmap_t&) = delete;
   pixmap_t(pixmap_t&&) noexcept;
   pixmap_t& operator=(const pixmap_t&) = delete;
-  pixmap_t& operator=(pixmap_t&&) = delete;
+  pixmap_t& operator=(pixmap_t&&) noexcept;
 
   void clear();
   void copy_from(const pixmap_t& rhs, coordinate_t src, coordinate_t dst,
                  uint16_t width, uint16_t height);
   [[nodiscard]] XftDraw* create_xft_draw() const;
+  void draw_glyphs(const std::vector<glyph_run_t>& runs);
+
+  [[nodiscard]] uint16_t width() const { return _width; }
 
  private:
   friend window_t;
-  pixmap_t(X11* x, xcb_drawable_t d, uint16_t width, uint16_t height);
+  friend image_t;
+  pixmap_t(X11* x, xcb_drawable_t d, gc_t gc, uint16_t width,
+           uint16_t height);
+
+  xcb_render_picture_t picture();
 
   X11* _x;
   xcb_pixmap_t _id;
+  gc_t _gc;
+  xcb_render_picture_t _picture{0};
+  uint16_t _width;
+  uint16_t _height;
+};
+
+
+/** image_t
+ * A client side image which is uploaded into pixmaps. It lives in memory shared
+ * with the server if MIT-SHM can be used, which makes an upload a single small
+ * request. Otherwise it is sent over the connection with PutImage.
+ */
+class X11::image_t {
+ public:
+  ~image_t();
+  image_t(const image_t&) = delete;
+  image_t(image_t&&) noexcept;
+  image_t& operator=(const image_t&) = delete;
+  image_t& operator=(image_t&&) noexcept;
+
+  // Waits until the server is done reading the last upload.
+  raster_t raster();
+  void put(const pixmap_t& pixmap, uint16_t width);
+
+  [[nodiscard]] uint16_t width() const { return _width; }
+  [[nodiscard]] bool shared() const { return _seg != 0; }
+
+ private:
+  friend X11;
+  image_t(X11* x, uint16_t width, uint16_t height);
+
+  void sync();
+
+  X11* _x;
   uint16_t _width;
   uint16_t _height;
+  uint32_t* _data{nullptr};
+  xcb_shm_seg_t _seg{0};
+  bool _pending{false};
 };
 
 
 class X11::rdb_t {
  public:
-  explicit rdb_t(X11* x);
+  rdb_t(X11* x, xcb_get_property_cookie_t cookie);
   ~rdb_t();
 
   rdb_t(const rdb_t&) = delete;
@@ -235,8 +426,22 @@ class X11::rdb_t {
   xcb_xrm_database_t* _db;
 };
 
+template <>
+std::string X11::rdb_t::get<std::string>(const char* query);
+
 
 // helpers
 
-xcb_atom_t get_atom(xcb_connection_t* conn, const char* name);
 xcb_connection_t* get_connection();
+
+// The queries of X11 on any EWMH connection, for modules which make them from
+// a worker thread on a connection of their own.
+auto get_windows(xcb_ewmh_connection_t* ewmh)
+    -> cppcoro::generator<xcb_window_t>;
+auto get_active_window(xcb_ewmh_connection_t* ewmh) -> xcb_window_t;
+auto get_window_title(xcb_ewmh_connection_t* ewmh, xcb_window_t win)
+    -> std::string;
+auto get_current_workspace(xcb_ewmh_connection_t* ewmh) -> uint32_t;
+auto get_workspace_of_window(xcb_ewmh_connection_t* ewmh, xcb_window_t window)
+    -> std::optional<uint32_t>;
+bool is_window_urgent(xcb_ewmh_connection_t* ewmh, xcb_window_t window);